@@ -2,4 +2,4 @@
 
 set -e
 
-g++ -Wall -Wextra -ggdb -std=c++0x -I/usr/include/SDL2/ zoomit.cpp -o zoomit -lX11 -lSDL2 -lGL -lGLEW -lGLU
+g++ -Wall -Wextra -O2 -ggdb -std=c++0x -I/usr/include/SDL2/ zoomit.cpp -o zoomit -lX11 -lXrandr -lSDL2 -lGL -lGLEW -lGLU -lz -pthread
@@ -0,0 +1,132 @@
+// Reference consumer for `zoomit --publish`: maps the shared frame ring and
+// reports end to end latency and dropped frames once per second.
+//
+//   g++ -Wall -Wextra -O2 -std=c++0x examples/framesink.cpp -o framesink
+//   ./framesink [path] [seconds]
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+// keep in sync with Publish::Header and Publish::Slot in zoomit.cpp
+struct Header {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t slotOffset;
+    uint32_t slotSize;
+    uint32_t slotCount;
+    uint32_t format;
+    uint32_t width, height;
+    uint32_t stride;
+    uint32_t pad;
+    std::atomic<uint64_t> latest;
+};
+
+struct Slot {
+    std::atomic<uint64_t> seq;
+    uint64_t frame;
+    uint64_t timestampNs;
+    uint64_t pad[5];
+};
+
+const uint32_t MAGIC   = 0x54494d5a;
+const uint32_t VERSION = 1;
+
+uint64_t nowNs()
+{
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+int main(int argc, char **argv)
+{
+    std::string path;
+    if (argc > 1) {
+        path = argv[1];
+    } else {
+        const char *dir = getenv("XDG_RUNTIME_DIR");
+        path = std::string(dir ? dir : "/tmp") + "/zoomit-frames";
+    }
+    const double seconds = argc > 2 ? atof(argv[2]) : 10.0;
+
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        fprintf(stderr, "ERROR: could not open %s: %s\n", path.c_str(), strerror(errno));
+        exit(1);
+    }
+    struct stat st;
+    fstat(fd, &st);
+    uint8_t *base = (uint8_t *)mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    if (base == MAP_FAILED) {
+        fprintf(stderr, "ERROR: could not map %s: %s\n", path.c_str(), strerror(errno));
+        exit(1);
+    }
+
+    Header *header = (Header *)base;
+    if (header->magic != MAGIC || header->version != VERSION) {
+        fprintf(stderr, "ERROR: %s is not a version %u zoomit frame ring\n", path.c_str(), VERSION);
+        exit(1);
+    }
+    printf("%ux%u frames, stride %u, %u slots\n",
+           header->width, header->height, header->stride, header->slotCount);
+
+    uint64_t last = header->latest.load(std::memory_order_acquire);
+    uint64_t received = 0, dropped = 0, torn = 0, checksum = 0;
+    double   latencySum = 0.0, latencyMax = 0.0;
+    uint64_t start = nowNs(), reportAt = start + 1000000000ull;
+
+    while (nowNs() - start < seconds * 1e9) {
+        uint64_t n = header->latest.load(std::memory_order_acquire);
+        if (n == last) {
+            timespec nap = {0, 200000};
+            nanosleep(&nap, nullptr);
+            continue;
+        }
+
+        Slot *slot = (Slot *)(base + header->slotOffset + (n % header->slotCount) * header->slotSize);
+        if (slot->seq.load(std::memory_order_acquire) != 2 * n) {
+            continue; // already being overwritten, catch the next one
+        }
+        // use the pixels in place, here just sample one row
+        const uint8_t *pixels = (const uint8_t *)(slot + 1);
+        const uint8_t *row    = pixels + (header->height / 2) * header->stride;
+        for (uint32_t x = 0; x < header->stride; x += 64) checksum += row[x];
+        const uint64_t stamp = slot->timestampNs;
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (slot->seq.load(std::memory_order_relaxed) != 2 * n) {
+            ++torn;
+            continue;
+        }
+
+        if (last != 0 && n > last + 1) dropped += n - last - 1;
+        last = n;
+        ++received;
+        double latency = (nowNs() - stamp) / 1e6;
+        latencySum += latency;
+        latencyMax  = latency > latencyMax ? latency : latencyMax;
+
+        if (nowNs() >= reportAt) {
+            printf("frame %llu: %llu received, %llu dropped, %llu torn, latency avg %.2fms max %.2fms\n",
+                   (unsigned long long)n, (unsigned long long)received, (unsigned long long)dropped,
+                   (unsigned long long)torn, latencySum / received, latencyMax);
+            reportAt += 1000000000ull;
+        }
+    }
+
+    printf("total: %llu received, %llu dropped, %llu torn, latency avg %.2fms max %.2fms (checksum %llu)\n",
+           (unsigned long long)received, (unsigned long long)dropped, (unsigned long long)torn,
+           received ? latencySum / received : 0.0, latencyMax, (unsigned long long)checksum);
+
+    munmap(base, st.st_size);
+    close(fd);
+    return(0);
+}
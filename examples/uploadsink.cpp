@@ -0,0 +1,156 @@
+// Local stand-in for the image host `zoomit --upload-url` posts to. Accepts
+// multipart uploads (chunked or not), checks that the part is a complete PNG
+// and answers like imgur does.
+//
+//   g++ -Wall -Wextra -O2 -std=c++0x examples/uploadsink.cpp -o uploadsink
+//   ./uploadsink [port] [out.png]
+//   ./zoomit --upload-url http://127.0.0.1:8080/3/image --bench-upload
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+struct Reader {
+    int         fd;
+    std::string buf;
+    size_t      pos = 0;
+
+    bool fill()
+    {
+        if (pos == buf.size()) {
+            buf.clear();
+            pos = 0;
+        }
+        char tmp[65536];
+        ssize_t n = recv(fd, tmp, sizeof(tmp), 0);
+        if (n <= 0) return false;
+        buf.append(tmp, n);
+        return true;
+    }
+
+    bool line(std::string &out)
+    {
+        size_t end;
+        while ((end = buf.find("\r\n", pos)) == std::string::npos) {
+            if (!fill()) return false;
+        }
+        out = buf.substr(pos, end - pos);
+        pos = end + 2;
+        return true;
+    }
+
+    bool read(size_t len, std::string &out)
+    {
+        while (buf.size() - pos < len) {
+            if (!fill()) return false;
+        }
+        out.append(buf, pos, len);
+        pos += len;
+        return true;
+    }
+};
+
+double msSince(std::chrono::steady_clock::time_point t)
+{
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t).count();
+}
+
+void serve(int fd, int port, const char *outPath)
+{
+    auto accepted = std::chrono::steady_clock::now();
+    Reader in;
+    in.fd = fd;
+
+    std::string requestLine, header, boundary;
+    bool   chunked = false;
+    size_t contentLength = 0;
+    in.line(requestLine);
+    while (in.line(header) && !header.empty()) {
+        if (header.find("Transfer-Encoding: chunked") == 0) chunked = true;
+        if (header.find("Content-Length:") == 0) contentLength = strtoul(header.c_str() + 15, nullptr, 10);
+        size_t b = header.find("boundary=");
+        if (b != std::string::npos) boundary = header.substr(b + 9);
+    }
+
+    std::string body;
+    double firstBodyMs = -1.0;
+    bool   complete    = false;
+    if (chunked) {
+        std::string sizeLine, crlf;
+        while (in.line(sizeLine)) {
+            size_t len = strtoul(sizeLine.c_str(), nullptr, 16);
+            if (firstBodyMs < 0) firstBodyMs = msSince(accepted);
+            if (len == 0) {
+                complete = in.line(crlf);
+                break;
+            }
+            if (!in.read(len, body) || !in.line(crlf)) break;
+        }
+    } else {
+        firstBodyMs = msSince(accepted);
+        complete    = in.read(contentLength, body);
+    }
+    const double totalMs = msSince(accepted);
+
+    // the image is between the part headers and the closing boundary
+    static const char signature[8] = {'\x89', 'P', 'N', 'G', '\r', '\n', '\x1a', '\n'};
+    size_t start = body.find("\r\n\r\n");
+    size_t end   = body.rfind("\r\n--" + boundary + "--");
+    std::string png;
+    if (!boundary.empty() && start != std::string::npos && end != std::string::npos && end > start) {
+        png = body.substr(start + 4, end - start - 4);
+    }
+    bool valid = complete && png.size() > 20 && memcmp(png.data(), signature, 8) == 0 &&
+                 png.compare(png.size() - 8, 4, "IEND") == 0;
+
+    printf("%s: %zu body bytes, png %zu bytes %s, first body byte after %.2fms, done after %.2fms\n",
+           requestLine.c_str(), body.size(), png.size(), valid ? "ok" : "INVALID", firstBodyMs, totalMs);
+    if (valid && outPath) {
+        FILE *f = fopen(outPath, "wb");
+        if (f) {
+            fwrite(png.data(), 1, png.size(), f);
+            fclose(f);
+        }
+    }
+
+    char json[256];
+    snprintf(json, sizeof(json),
+             "{\"data\":{\"link\":\"http://127.0.0.1:%d/zoomit.png\",\"size\":%zu},\"success\":%s,\"status\":%d}",
+             port, png.size(), valid ? "true" : "false", valid ? 200 : 400);
+    char response[512];
+    int n = snprintf(response, sizeof(response),
+                     "HTTP/1.1 %s\r\nContent-Type: application/json\r\nContent-Length: %zu\r\nConnection: close\r\n\r\n%s",
+                     valid ? "200 OK" : "400 Bad Request", strlen(json), json);
+    send(fd, response, n, MSG_NOSIGNAL);
+    close(fd);
+}
+
+int main(int argc, char **argv)
+{
+    const int   port    = argc > 1 ? atoi(argv[1]) : 8080;
+    const char *outPath = argc > 2 ? argv[2] : nullptr;
+
+    int server = socket(AF_INET, SOCK_STREAM, 0);
+    int yes    = 1;
+    setsockopt(server, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(yes));
+    sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family      = AF_INET;
+    addr.sin_port        = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (bind(server, (sockaddr *)&addr, sizeof(addr)) < 0 || listen(server, 4) < 0) {
+        fprintf(stderr, "ERROR: could not listen on port %d\n", port);
+        exit(1);
+    }
+    printf("Listening on http://127.0.0.1:%d\n", port);
+
+    for (;;) {
+        int fd = accept(server, nullptr, nullptr);
+        if (fd >= 0) serve(fd, port, outPath);
+    }
+}
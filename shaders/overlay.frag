@@ -0,0 +1,42 @@
+#version 330 core
+out vec4 FragColor;
+
+in vec3 ourColor;
+in vec2 TexCoord;
+
+uniform vec2  imgSize;
+uniform vec4  selection;  // x0, y0, x1, y1 in window pixels, top left origin
+uniform vec3  probeColor; // pixel under the cursor
+uniform vec3  meanColor;  // of the selection
+uniform float hasStats;
+// 256x1, bar height of every bin per channel
+uniform sampler2D histogram;
+
+// bottom left corner: 512 px of histogram (2 px per bin) and two swatches
+const vec2 panelPos  = vec2(16.0, 16.0);
+const vec2 panelSize = vec2(600.0, 160.0);
+
+void main()
+{
+    vec2 p = vec2(gl_FragCoord.x, imgSize.y - gl_FragCoord.y);
+    bool inside  = all(greaterThanEqual(p, selection.xy - 1.0)) && all(lessThanEqual(p, selection.zw + 1.0));
+    bool onInner = all(greaterThan(p, selection.xy + 1.0)) && all(lessThan(p, selection.zw - 1.0));
+    if (inside && !onInner) {
+        FragColor = vec4(1.0, 1.0, 0.0, 1.0);
+        return;
+    }
+
+    vec2 q = gl_FragCoord.xy - panelPos;
+    if (any(lessThan(q, vec2(0.0))) || any(greaterThan(q, panelSize))) discard;
+
+    vec3 color = vec3(0.1);
+    if (q.x < 512.0) {
+        if (hasStats > 0.5) {
+            vec3 bars = texelFetch(histogram, ivec2(int(q.x) / 2, 0), 0).rgb;
+            color = mix(color, vec3(0.9) * step(vec3(q.y / panelSize.y), bars), 0.9);
+        }
+    } else if (q.x > 520.0) {
+        color = q.y > panelSize.y / 2.0 ? probeColor : (hasStats > 0.5 ? meanColor : color);
+    }
+    FragColor = vec4(color, 1.0);
+}
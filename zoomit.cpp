@@ -2,15 +2,35 @@
 
 #include <X11/Xlib.h> // ----> https://tronche.com/gui/x/xlib/function-index.html
 #include <X11/Xutil.h>
+#include <X11/cursorfont.h>
+#include <X11/extensions/Xrandr.h>
 #include <algorithm>
-#include <cassert>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
 #include <cmath>
+#include <cstdint>
 #include <cstdlib>
+#include <cstring>
 #include <fstream>
 #include <functional>
+#include <future>
 #include <iostream>
+#include <mutex>
+#include <new>
 #include <string>
+#include <thread>
 #include <vector>
+#include <fcntl.h>
+#include <netdb.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+#include <zlib.h>
 
 #include <SDL.h>
 #include <GL/glew.h>
@@ -18,29 +38,563 @@
 #include <GL/glext.h>
 #include <GL/glu.h>
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#include <tmmintrin.h>
+#endif
+
 namespace GloballyAvail
 {
     float time = 0;
 }
 
+// Turns whatever XGetImage hands back into the layout the desktop texture is
+// uploaded as: 4 bytes per pixel, B G R X in memory (GL_BGRA / GL_UNSIGNED_BYTE).
+namespace PixelFormat
+{
+    enum Layout {
+        PF_BGRX8888 = 0, // already the upload format
+        PF_PACKED32,     // 32bpp with >= 8 bit channels (RGBX8888, 10-10-10-2, ...)
+        PF_RGB565,
+        PF_BGR888,       // packed 24bpp
+        PF_GENERIC,      // anything else, driven by the masks
+        PF_COUNT
+    };
+
+    static_assert(PF_COUNT == 5, "Update list of pixel layouts");
+    static const char *pfName[PF_COUNT] = {
+        [PF_BGRX8888] = "BGRX8888",
+        [PF_PACKED32] = "PACKED32",
+        [PF_RGB565]   = "RGB565",
+        [PF_BGR888]   = "BGR888",
+        [PF_GENERIC]  = "GENERIC",
+    };
+
+    struct Channel {
+        int shift, bits;
+    };
+
+    struct Format {
+        int     bpp;
+        bool    msbFirst;
+        Channel r, g, b;
+        Layout  layout;
+    };
+
+    Channel channelFromMask(unsigned long mask)
+    {
+        Channel c = {0, 0};
+        if (mask == 0) return c;
+        while (!(mask & 1)) {mask >>= 1; ++c.shift;}
+        while (mask & 1)    {mask >>= 1; ++c.bits;}
+        return c;
+    }
+
+    bool isChannel(Channel c, int shift, int bits)
+    {
+        return c.shift == shift && c.bits == bits;
+    }
+
+    Format describe(int bpp, int byteOrder, unsigned long rMask, unsigned long gMask, unsigned long bMask)
+    {
+        Format f;
+        f.bpp      = bpp;
+        f.msbFirst = (byteOrder == MSBFirst);
+        f.r        = channelFromMask(rMask);
+        f.g        = channelFromMask(gMask);
+        f.b        = channelFromMask(bMask);
+        f.layout   = PF_GENERIC;
+
+        // the fast paths read pixels as little endian words
+        if (f.msbFirst || __BYTE_ORDER__ != __ORDER_LITTLE_ENDIAN__) return f;
+
+        if (bpp == 32 && isChannel(f.r, 16, 8) && isChannel(f.g, 8, 8) && isChannel(f.b, 0, 8)) {
+            f.layout = PF_BGRX8888;
+        } else if (bpp == 32 && f.r.bits >= 8 && f.g.bits >= 8 && f.b.bits >= 8) {
+            f.layout = PF_PACKED32;
+        } else if (bpp == 16 && isChannel(f.r, 11, 5) && isChannel(f.g, 5, 6) && isChannel(f.b, 0, 5)) {
+            f.layout = PF_RGB565;
+        } else if (bpp == 24 && isChannel(f.r, 16, 8) && isChannel(f.g, 8, 8) && isChannel(f.b, 0, 8)) {
+            f.layout = PF_BGR888;
+        }
+        return f;
+    }
+
+    Format describe(XImage *image)
+    {
+        return describe(image->bits_per_pixel, image->byte_order,
+                        image->red_mask, image->green_mask, image->blue_mask);
+    }
+
+    bool isSupported(Format const &f)
+    {
+        return (f.bpp == 8 || f.bpp == 16 || f.bpp == 24 || f.bpp == 32) &&
+               f.r.bits > 0 && f.g.bits > 0 && f.b.bits > 0;
+    }
+
+    // scale an n bit channel to 8 bits by bit replication, so that full
+    // intensity stays full intensity (0x1f -> 0xff)
+    uint8_t expand(uint32_t pixel, Channel c)
+    {
+        uint32_t v = (pixel >> c.shift) & ((1u << c.bits) - 1);
+        if (c.bits >= 8) return v >> (c.bits - 8);
+        uint32_t res = 0;
+        int filled = 0;
+        while (filled < 8) {
+            res     = (res << c.bits) | v;
+            filled += c.bits;
+        }
+        return res >> (filled - 8);
+    }
+
+    void rowGeneric(const uint8_t *src, uint8_t *dst, int width, Format const &f)
+    {
+        const int bytes = f.bpp / 8;
+        for (int x = 0; x < width; ++x) {
+            const uint8_t *p = src + x * bytes;
+            uint32_t v = 0;
+            for (int i = 0; i < bytes; ++i) {
+                v = (v << 8) | p[f.msbFirst ? i : bytes - 1 - i];
+            }
+            dst[x * 4 + 0] = expand(v, f.b);
+            dst[x * 4 + 1] = expand(v, f.g);
+            dst[x * 4 + 2] = expand(v, f.r);
+            dst[x * 4 + 3] = 0xff;
+        }
+    }
+
+    void rowPacked32(const uint8_t *src, uint32_t *dst, int width, Format const &f)
+    {
+        // keep the top 8 bits of every channel
+        const int rs = f.r.shift + f.r.bits - 8,
+                  gs = f.g.shift + f.g.bits - 8,
+                  bs = f.b.shift + f.b.bits - 8;
+        int x = 0;
+#if defined(__SSE2__)
+        const __m128i lo8   = _mm_set1_epi32(0xff),
+                      alpha = _mm_set1_epi32((int)0xff000000),
+                      rsh   = _mm_cvtsi32_si128(rs),
+                      gsh   = _mm_cvtsi32_si128(gs),
+                      bsh   = _mm_cvtsi32_si128(bs);
+        for (; x + 4 <= width; x += 4) {
+            __m128i p = _mm_loadu_si128((const __m128i *)(src + x * 4));
+            __m128i b = _mm_and_si128(_mm_srl_epi32(p, bsh), lo8);
+            __m128i g = _mm_and_si128(_mm_srl_epi32(p, gsh), lo8);
+            __m128i r = _mm_and_si128(_mm_srl_epi32(p, rsh), lo8);
+            __m128i o = _mm_or_si128(_mm_or_si128(b, _mm_slli_epi32(g, 8)),
+                                     _mm_or_si128(_mm_slli_epi32(r, 16), alpha));
+            _mm_storeu_si128((__m128i *)(dst + x), o);
+        }
+#endif
+        for (; x < width; ++x) {
+            uint32_t p; memcpy(&p, src + x * 4, 4);
+            dst[x] = ((p >> bs) & 0xff)         |
+                     (((p >> gs) & 0xff) << 8)  |
+                     (((p >> rs) & 0xff) << 16) | 0xff000000u;
+        }
+    }
+
+    void rowRGB565(const uint8_t *src, uint32_t *dst, int width)
+    {
+        int x = 0;
+#if defined(__SSE2__)
+        const __m128i m5    = _mm_set1_epi16(0x1f),
+                      m6    = _mm_set1_epi16(0x3f),
+                      alpha = _mm_set1_epi16((short)0xff00);
+        for (; x + 8 <= width; x += 8) {
+            __m128i p  = _mm_loadu_si128((const __m128i *)(src + x * 2));
+            __m128i r5 = _mm_srli_epi16(p, 11);
+            __m128i g6 = _mm_and_si128(_mm_srli_epi16(p, 5), m6);
+            __m128i b5 = _mm_and_si128(p, m5);
+            __m128i r8 = _mm_or_si128(_mm_slli_epi16(r5, 3), _mm_srli_epi16(r5, 2));
+            __m128i g8 = _mm_or_si128(_mm_slli_epi16(g6, 2), _mm_srli_epi16(g6, 4));
+            __m128i b8 = _mm_or_si128(_mm_slli_epi16(b5, 3), _mm_srli_epi16(b5, 2));
+            // interleave (b | g << 8) with (r | a << 8) into whole pixels
+            __m128i bg = _mm_or_si128(b8, _mm_slli_epi16(g8, 8));
+            __m128i ra = _mm_or_si128(r8, alpha);
+            _mm_storeu_si128((__m128i *)(dst + x),     _mm_unpacklo_epi16(bg, ra));
+            _mm_storeu_si128((__m128i *)(dst + x + 4), _mm_unpackhi_epi16(bg, ra));
+        }
+#endif
+        static const Channel r = {11, 5}, g = {5, 6}, b = {0, 5};
+        for (; x < width; ++x) {
+            uint16_t p; memcpy(&p, src + x * 2, 2);
+            dst[x] = expand(p, b) | (expand(p, g) << 8) | (expand(p, r) << 16) | 0xff000000u;
+        }
+    }
+
+#if defined(__SSE2__)
+    bool hasSSSE3()
+    {
+        static bool has = (__builtin_cpu_init(), __builtin_cpu_supports("ssse3"));
+        return has;
+    }
+
+    __attribute__((target("ssse3")))
+    int rowBGR888SSSE3(const uint8_t *src, uint32_t *dst, int width)
+    {
+        const __m128i shuf  = _mm_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1),
+                      alpha = _mm_set1_epi32((int)0xff000000);
+        int x = 0;
+        // every load reads 16 bytes but only uses 12 of them, stop early
+        // enough to never read past the end of the row
+        for (; x + 6 <= width; x += 4) {
+            __m128i p = _mm_loadu_si128((const __m128i *)(src + x * 3));
+            _mm_storeu_si128((__m128i *)(dst + x), _mm_or_si128(_mm_shuffle_epi8(p, shuf), alpha));
+        }
+        return x;
+    }
+#endif
+
+    void rowBGR888(const uint8_t *src, uint32_t *dst, int width)
+    {
+        int x = 0;
+#if defined(__SSE2__)
+        if (hasSSSE3()) x = rowBGR888SSSE3(src, dst, width);
+#endif
+        for (; x < width; ++x) {
+            const uint8_t *p = src + x * 3;
+            dst[x] = p[0] | (p[1] << 8) | (p[2] << 16) | 0xff000000u;
+        }
+    }
+
+    void convert(const uint8_t *src, int srcStride, uint8_t *dst, int width, int height, Format const &f)
+    {
+        for (int y = 0; y < height; ++y) {
+            const uint8_t *row = src + (size_t)y * srcStride;
+            uint8_t       *out = dst + (size_t)y * width * 4;
+            switch (f.layout) {
+                case PF_BGRX8888: memcpy(out, row, width * 4);                     break;
+                case PF_PACKED32: rowPacked32(row, (uint32_t *)out, width, f);     break;
+                case PF_RGB565:   rowRGB565(row, (uint32_t *)out, width);          break;
+                case PF_BGR888:   rowBGR888(row, (uint32_t *)out, width);          break;
+                default:          rowGeneric(row, out, width, f);                  break;
+            }
+        }
+    }
+
+    // ./zoomit --bench-convert
+    bool benchmark()
+    {
+        const int W = 3840, H = 2160, RUNS = 20;
+        struct Case {
+            const char   *label;
+            int           bpp;
+            unsigned long r, g, b;
+        };
+        const Case cases[] = {
+            {"BGRX8888",  32, 0xff0000,   0xff00,  0xff},
+            {"RGBX8888",  32, 0xff,       0xff00,  0xff0000},
+            {"RGB101010", 32, 0x3ff00000, 0xffc00, 0x3ff},
+            {"RGB565",    16, 0xf800,     0x7e0,   0x1f},
+            {"BGR888",    24, 0xff0000,   0xff00,  0xff},
+            {"RGB555",    16, 0x7c00,     0x3e0,   0x1f},
+        };
+
+        std::vector<uint8_t> src, dst(W * H * 4), ref(W * H * 4);
+        uint32_t seed = 0x2545f491;
+        bool allOk = true;
+        printf("Converting %dx%d to BGRX8888, best of %d runs\n", W, H, RUNS);
+        for (Case const &c : cases) {
+            Format f = describe(c.bpp, LSBFirst, c.r, c.g, c.b);
+            const int stride = W * c.bpp / 8;
+            src.resize((size_t)stride * H);
+            for (uint8_t &b : src) {
+                seed ^= seed << 13; seed ^= seed >> 17; seed ^= seed << 5;
+                b = seed;
+            }
+
+            // check the fast path against the mask driven one, alpha aside
+            Format generic = f;
+            generic.layout = PF_GENERIC;
+            convert(src.data(), stride, ref.data(), W, H, generic);
+            convert(src.data(), stride, dst.data(), W, H, f);
+            bool ok = true;
+            for (size_t i = 0; i < dst.size() && ok; ++i) {
+                ok = (i % 4 == 3) || dst[i] == ref[i];
+            }
+
+            double best = 1e9;
+            for (int run = 0; run < RUNS; ++run) {
+                auto t0 = std::chrono::steady_clock::now();
+                convert(src.data(), stride, dst.data(), W, H, f);
+                auto t1 = std::chrono::steady_clock::now();
+                best = std::min(best, std::chrono::duration<double, std::milli>(t1 - t0).count());
+            }
+            printf("%-10s via %-8s %8.2f ms %9.1f Mpx/s %s\n",
+                   c.label, pfName[f.layout], best, (W * H) / (best * 1000.0),
+                   ok ? "ok" : "MISMATCH");
+            allOk = allOk && ok;
+        }
+        return allOk;
+    }
+}
+
+// Lets the presenter pick what to zoom on before anything is captured:
+// drag a rectangle, or click once to take the top level window under the
+// pointer.
+namespace Selection
+{
+    struct Rect {
+        int x, y, w, h;
+    };
+
+    // XGetImage fails on anything reaching outside of the root window
+    Rect clip(Rect r, int maxW, int maxH)
+    {
+        int x0 = std::max(r.x, 0),          y0 = std::max(r.y, 0);
+        int x1 = std::min(r.x + r.w, maxW), y1 = std::min(r.y + r.h, maxH);
+        Rect res = {x0, y0, std::max(x1 - x0, 0), std::max(y1 - y0, 0)};
+        return res;
+    }
+
+    void drawBand(Display *display, Window root, GC gc, Rect r)
+    {
+        if (r.w > 0 && r.h > 0) XDrawRectangle(display, root, gc, r.x, r.y, r.w - 1, r.h - 1);
+    }
+
+    Rect fromCorners(int x0, int y0, int x1, int y1)
+    {
+        Rect r = {std::min(x0, x1), std::min(y0, y1), abs(x1 - x0) + 1, abs(y1 - y0) + 1};
+        return r;
+    }
+
+    // top level windows come from XQueryTree in bottom to top stacking
+    // order, so the first viewable one from the back containing the point wins
+    bool windowAt(Display *display, Window root, int px, int py, Rect &out)
+    {
+        Window rootRet, parentRet, *children = nullptr;
+        unsigned int count = 0;
+        if (!XQueryTree(display, root, &rootRet, &parentRet, &children, &count)) return false;
+        bool found = false;
+        for (int i = (int)count - 1; i >= 0 && !found; --i) {
+            XWindowAttributes a;
+            if (!XGetWindowAttributes(display, children[i], &a)) continue;
+            if (a.map_state != IsViewable || a.c_class == InputOnly) continue;
+            Rect r = {a.x, a.y, a.width + 2 * a.border_width, a.height + 2 * a.border_width};
+            if (px >= r.x && px < r.x + r.w && py >= r.y && py < r.y + r.h) {
+                out   = r;
+                found = true;
+            }
+        }
+        if (children) XFree(children);
+        return found;
+    }
+
+    bool select(Display *display, Window root, Rect &out)
+    {
+        Cursor cursor = XCreateFontCursor(display, XC_crosshair);
+        if (XGrabPointer(display, root, False, ButtonPressMask | ButtonReleaseMask | PointerMotionMask,
+                         GrabModeAsync, GrabModeAsync, None, cursor, CurrentTime) != GrabSuccess) {
+            fprintf(stderr, "ERROR: could not grab the pointer to select a region\n");
+            exit(1);
+        }
+        XGrabKeyboard(display, root, False, GrabModeAsync, GrabModeAsync, CurrentTime);
+
+        XGCValues gcv;
+        gcv.function       = GXxor;
+        gcv.foreground     = WhitePixel(display, DefaultScreen(display));
+        gcv.subwindow_mode = IncludeInferiors;
+        gcv.line_width     = 2;
+        GC gc = XCreateGC(display, root, GCFunction | GCForeground | GCSubwindowMode | GCLineWidth, &gcv);
+
+        bool done = false, selected = false, dragging = false;
+        int  startX = 0, startY = 0;
+        Rect band = {0, 0, 0, 0};
+        while (!done) {
+            XEvent xev;
+            XNextEvent(display, &xev);
+            switch (xev.type) {
+                case ButtonPress: {
+                    startX   = xev.xbutton.x_root;
+                    startY   = xev.xbutton.y_root;
+                    dragging = true;
+                } break;
+                case MotionNotify: {
+                    if (!dragging) break;
+                    drawBand(display, root, gc, band); // xor, so this erases it
+                    band = fromCorners(startX, startY, xev.xmotion.x_root, xev.xmotion.y_root);
+                    drawBand(display, root, gc, band);
+                } break;
+                case ButtonRelease: {
+                    if (!dragging) break;
+                    drawBand(display, root, gc, band);
+                    band = fromCorners(startX, startY, xev.xbutton.x_root, xev.xbutton.y_root);
+                    // a click without dragging picks the window under it
+                    if (band.w < 4 || band.h < 4) {
+                        selected = windowAt(display, root, startX, startY, out);
+                    } else {
+                        out      = band;
+                        selected = true;
+                    }
+                    done = true;
+                } break;
+                case KeyPress: {
+                    if (XLookupKeysym(&xev.xkey, 0) == XK_Escape) {
+                        drawBand(display, root, gc, band);
+                        done = true;
+                    }
+                } break;
+            }
+        }
+
+        XUngrabKeyboard(display, CurrentTime);
+        XUngrabPointer(display, CurrentTime);
+        XFreeGC(display, gc);
+        XFreeCursor(display, cursor);
+        XSync(display, False);
+        return selected;
+    }
+}
+
+// Monitors as XRandR sees them. ZoomIt only captures and draws on the one
+// under the pointer, so the others are left alone and vsync follows that
+// output's refresh rate instead of whatever the root window spans.
+namespace Outputs
+{
+    struct Output {
+        std::string     name;
+        Selection::Rect rect;
+        double          refresh; // Hz, 0 if unknown
+    };
+
+    double refreshOf(XRRScreenResources const *res, RRMode id)
+    {
+        for (int i = 0; i < res->nmode; ++i) {
+            XRRModeInfo const &m = res->modes[i];
+            if (m.id != id || m.hTotal == 0 || m.vTotal == 0) continue;
+            double rate = (double)m.dotClock / ((double)m.hTotal * m.vTotal);
+            if (m.modeFlags & RR_DoubleScan) rate /= 2.0;
+            if (m.modeFlags & RR_Interlace)  rate *= 2.0;
+            return rate;
+        }
+        return 0.0;
+    }
+
+    std::vector<Output> query(Display *display, Window root)
+    {
+        std::vector<Output> outputs;
+        int eventBase, errorBase;
+        if (!XRRQueryExtension(display, &eventBase, &errorBase)) return outputs;
+        XRRScreenResources *res = XRRGetScreenResourcesCurrent(display, root);
+        if (res == nullptr) return outputs;
+        for (int i = 0; i < res->noutput; ++i) {
+            XRROutputInfo *info = XRRGetOutputInfo(display, res, res->outputs[i]);
+            if (info == nullptr) continue;
+            if (info->connection == RR_Connected && info->crtc) {
+                XRRCrtcInfo *crtc = XRRGetCrtcInfo(display, res, info->crtc);
+                if (crtc && crtc->width > 0 && crtc->height > 0) {
+                    Output o;
+                    o.name = std::string(info->name, info->nameLen);
+                    Selection::Rect r = {crtc->x, crtc->y, (int)crtc->width, (int)crtc->height};
+                    o.rect    = r;
+                    o.refresh = refreshOf(res, crtc->mode);
+                    outputs.push_back(o);
+                }
+                if (crtc) XRRFreeCrtcInfo(crtc);
+            }
+            XRRFreeOutputInfo(info);
+        }
+        XRRFreeScreenResources(res);
+        return outputs;
+    }
+
+    int at(std::vector<Output> const &outputs, int px, int py)
+    {
+        for (size_t i = 0; i < outputs.size(); ++i) {
+            Selection::Rect const &r = outputs[i].rect;
+            if (px >= r.x && px < r.x + r.w && py >= r.y && py < r.y + r.h) return i;
+        }
+        return outputs.empty() ? -1 : 0;
+    }
+
+    int underPointer(Display *display, Window root, std::vector<Output> const &outputs)
+    {
+        Window rootRet, childRet;
+        int px = 0, py = 0, wx, wy;
+        unsigned int mask;
+        XQueryPointer(display, root, &rootRet, &childRet, &px, &py, &wx, &wy, &mask);
+        return at(outputs, px, py);
+    }
+}
+
+// Frame times of the zoom loop, printed with 't' and on exit
+namespace FrameStats
+{
+    const int RECENT = 1024;
+
+    std::string output = "root";
+    double   expectedMs = 0.0; // one refresh of the output, 0 if unknown
+    uint64_t frames = 0, late = 0;
+    double   totalMs = 0.0, maxMs = 0.0;
+    float    recent[RECENT];
+
+    void record(double dt)
+    {
+        const double ms = dt * 1000.0;
+        recent[frames % RECENT] = ms;
+        ++frames;
+        totalMs += ms;
+        maxMs    = std::max(maxMs, ms);
+        // took longer than one refresh and a half, so at least one vblank was missed
+        if (expectedMs > 0.0 && ms > expectedMs * 1.5) ++late;
+    }
+
+    void report()
+    {
+        if (frames == 0) return;
+        const int n = std::min<uint64_t>(frames, RECENT);
+        std::vector<float> sorted(recent, recent + n);
+        std::sort(sorted.begin(), sorted.end());
+        printf("Frames on %s: %llu, avg %.2fms, p50 %.2fms, p99 %.2fms (last %d), max %.2fms, %llu late",
+               output.c_str(), (unsigned long long)frames, totalMs / frames,
+               sorted[n / 2], sorted[std::min(n - 1, n * 99 / 100)], n, maxMs, (unsigned long long)late);
+        if (expectedMs > 0.0) printf(" (> %.2fms)", expectedMs * 1.5);
+        printf("\n");
+    }
+}
+
 struct Screenshoot {
     Display *display;
     Window   root;
     XImage  *image=nullptr;
+    int   x, y; // offset of the captured area inside of root
     int   width, height;
-    char *data=nullptr;
+    char *data=nullptr; // always BGRX8888, tightly packed
+    PixelFormat::Format  format;
+    std::vector<uint8_t> converted;
 
     Screenshoot() = delete;
-    explicit Screenshoot(Display *dsp, Window r, int w, int h)
-        : display(dsp), root(r), width(w), height(h)
+    explicit Screenshoot(Display *dsp, Window r, int x_, int y_, int w, int h)
+        : display(dsp), root(r), x(x_), y(y_), width(w), height(h)
     {}
 
     void capture() {
         if (image != nullptr) XDestroyImage(image);
-        image = XGetImage(display, root, 0, 0, width, height, AllPlanes, ZPixmap);
-        printf("Bits per pixel: %d\n", image->bits_per_pixel);
-        assert((image->bits_per_pixel == 32) && "ASSERT: Image's bits per pixel should be 32");
-        data = image->data;
+        image = XGetImage(display, root, x, y, width, height, AllPlanes, ZPixmap);
+        if (image == nullptr) {
+            fprintf(stderr, "ERROR: could not capture the screen\n");
+            exit(1);
+        }
+        format = PixelFormat::describe(image);
+        printf("Bits per pixel: %d, layout: %s\n", image->bits_per_pixel, PixelFormat::pfName[format.layout]);
+        if (!PixelFormat::isSupported(format)) {
+            fprintf(stderr, "ERROR: unsupported visual (%d bits per pixel, masks %lx %lx %lx)\n",
+                    image->bits_per_pixel, image->red_mask, image->green_mask, image->blue_mask);
+            exit(1);
+        }
+
+        if (format.layout == PixelFormat::PF_BGRX8888 && image->bytes_per_line == width * 4) {
+            data = image->data;
+            return;
+        }
+        auto t0 = std::chrono::steady_clock::now();
+        converted.resize((size_t)width * height * 4);
+        PixelFormat::convert((const uint8_t *)image->data, image->bytes_per_line,
+                             converted.data(), width, height, format);
+        data = (char *)converted.data();
+        auto t1 = std::chrono::steady_clock::now();
+        printf("Converted capture in %.2fms\n", std::chrono::duration<double, std::milli>(t1 - t0).count());
     }
 
     void saveToPPM(const char *fp) {
@@ -106,6 +660,7 @@ namespace Camera
     V2 p(0.0); // position for the top left corner of the camera
     V2 velocity(0.0);
     V2 scalePivot(0.0);
+    V2 bounds(0.0); // size of the captured image, the camera never leaves it
 }
 
 #define INITIAL_RAD (60.0f)
@@ -128,6 +683,20 @@ V2 world(V2 vec)
     return (vec - Camera::p) / V2(Mouse::scaleMagnitude);
 }
 
+// screen.vert scales the image around the middle of the window, these two
+// map between window and image pixels exactly the way it draws them
+V2 imagePoint(V2 screen)
+{
+    V2 half = Camera::bounds / V2(2.0);
+    return (screen - half) / V2(Mouse::scaleMagnitude) + half - Camera::p / V2(2.0);
+}
+
+V2 screenPoint(V2 image)
+{
+    V2 half = Camera::bounds / V2(2.0);
+    return (image - half + Camera::p / V2(2.0)) * V2(Mouse::scaleMagnitude) + half;
+}
+
 void update(double dt)
 {
     if (fabs(Mouse::deltaScale) > 0.5) {
@@ -147,6 +716,21 @@ void update(double dt)
         Camera::p        += Camera::velocity * V2(5 * dt);
         Camera::velocity -= Camera::velocity.normalized() * V2(dt) * V2(100.0);
     }
+    // screen.vert scales around the center of the screen, so at scale s the
+    // image still covers the window for |p| <= size * (1 - 1 / s). Below 1
+    // the image is smaller than the window and just stays centered.
+    {
+        double slack = std::max(0.0, 1.0 - 1.0 / Mouse::scaleMagnitude);
+        V2 limit     = Camera::bounds * V2(slack);
+        if (fabs(Camera::p.x) > limit.x) {
+            Camera::p.x        = sign(Camera::p.x) * limit.x;
+            Camera::velocity.x = 0.0;
+        }
+        if (fabs(Camera::p.y) > limit.y) {
+            Camera::p.y        = sign(Camera::p.y) * limit.y;
+            Camera::velocity.y = 0.0;
+        }
+    }
     // lamp
     if (abs(Lamp::deltaRad) > 1.0) {
         Lamp::radius    = std::max(0.0, Lamp::radius + Lamp::deltaRad * dt);
@@ -164,6 +748,7 @@ namespace Gfx
     enum Program {
         P_SCENE = 0,
         P_DESKTOP,
+        P_OVERLAY,
         P_COUNT
     };
 
@@ -175,10 +760,15 @@ namespace Gfx
         U_LAMP_POS,
         U_LAMP_SHADOW,
         U_LAMP_RADIUS,
+        U_SELECTION,
+        U_PROBE_COLOR,
+        U_MEAN_COLOR,
+        U_HAS_STATS,
+        U_HISTOGRAM,
         U_COUNT
     };
 
-    static_assert(U_COUNT == 7, "Update list of uniforms");
+    static_assert(U_COUNT == 12, "Update list of uniforms");
     static const char *uName[U_COUNT] = {
         [U_IMG_SZ]       = "imgSize",
         [U_SCREEN_SCALE] = "scale",
@@ -187,6 +777,11 @@ namespace Gfx
         [U_LAMP_POS]     = "lampPos",
         [U_LAMP_SHADOW]  = "shadow",
         [U_LAMP_RADIUS]  = "radius",
+        [U_SELECTION]    = "selection",
+        [U_PROBE_COLOR]  = "probeColor",
+        [U_MEAN_COLOR]   = "meanColor",
+        [U_HAS_STATS]    = "hasStats",
+        [U_HISTOGRAM]    = "histogram",
     };
     enum VertexAttrib {
         VA_POS = 0,
@@ -336,8 +931,1391 @@ namespace Gfx
     }
 }
 
-int main()
+// BGRX test image for the benchmarks: flat colored panels with some busy
+// "text" rows, roughly what a desktop compresses like
+std::vector<uint8_t> syntheticDesktop(int w, int h)
+{
+    std::vector<uint8_t> pixels((size_t)w * h * 4);
+    uint32_t seed = 0x9e3779b9;
+    for (int y = 0; y < h; ++y) {
+        for (int x = 0; x < w; ++x) {
+            uint32_t c = 0x203040 + ((x / 480 + y / 270) % 5) * 0x182818;
+            if ((y % 24) < 12 && ((x / 320 + y / 24) % 3) == 0) {
+                seed ^= seed << 13; seed ^= seed >> 17; seed ^= seed << 5;
+                c ^= seed & 0x3f3f3f;
+            }
+            memcpy(&pixels[((size_t)y * w + x) * 4], &c, 4);
+        }
+    }
+    return pixels;
+}
+
+// Sessions are saved as one flat, native endian file:
+//
+//   FileHeader | TileEntry[tilesX * tilesY] | Stroke[] | Point[] | tile data
+//
+// Loading maps the file and checks the header, nothing else. The tables are
+// used in place and tiles (zlib compressed BGRX rows) are only decoded once
+// they are about to be shown.
+namespace Session
 {
+    const uint32_t MAGIC   = 0x53534d5a; // "ZMSS"
+    const uint32_t VERSION = 1;
+    const int      TILE    = 256;
+    const uint32_t MAX_SIDE = 32768; // well past any GL_MAX_TEXTURE_SIZE
+
+    struct FileHeader {
+        uint32_t magic, version;
+        int32_t  originX, originY; // where the capture was on screen
+        uint32_t width, height;
+        uint32_t tileSize, tilesX, tilesY;
+        uint32_t lampEnabled;
+        double   cameraX, cameraY;
+        float    scale, lampRadius;
+        uint64_t tileIndexOffset;
+        uint64_t strokeOffset, strokeCount;
+        uint64_t pointOffset, pointCount;
+    };
+
+    struct TileEntry {
+        uint64_t offset;
+        uint32_t size; // compressed
+        uint32_t pad;
+    };
+
+    // one annotation stroke, made of points[first .. first + count)
+    struct Stroke {
+        uint32_t first, count;
+        uint32_t color; // 0xAARRGGBB
+        float    width;
+    };
+
+    struct Point {
+        float x, y; // image coordinates
+    };
+
+    enum TileState {
+        TS_EMPTY = 0,
+        TS_DECODED,
+        TS_UPLOADED
+    };
+
+    struct Mapped {
+        uint8_t          *base     = nullptr;
+        size_t            size     = 0;
+        FileHeader const *header   = nullptr;
+        TileEntry  const *tiles    = nullptr;
+        Stroke     const *strokes  = nullptr;
+        Point      const *points   = nullptr;
+        uint8_t          *pixels   = nullptr; // BGRX, filled in as tiles get decoded
+        size_t            nextTile = 0;       // background decoding cursor
+        std::vector<uint8_t> state;
+    };
+
+    void tileRect(FileHeader const &h, size_t i, int &x, int &y, int &w, int &ht)
+    {
+        x  = (i % h.tilesX) * h.tileSize;
+        y  = (i / h.tilesX) * h.tileSize;
+        w  = std::min<int>(h.tileSize, h.width  - x);
+        ht = std::min<int>(h.tileSize, h.height - y);
+    }
+
+    // what restore() brings back, taken on the main thread
+    struct View {
+        double cameraX, cameraY;
+        float  scale, lampRadius;
+        bool   lampEnabled;
+    };
+
+    View currentView()
+    {
+        View v = {Camera::p.x, Camera::p.y, Mouse::scaleMagnitude, Lamp::radius, Lamp::isEnabled};
+        return v;
+    }
+
+    bool save(const char *path, const uint8_t *pixels, Selection::Rect area, View const &view,
+              const Stroke *strokes, uint64_t strokeCount, const Point *points, uint64_t pointCount)
+    {
+        // write next to it and rename, the old file may still be mapped
+        std::string tmp = std::string(path) + ".tmp";
+        FILE *f = fopen(tmp.c_str(), "wb");
+        if (!f) {
+            fprintf(stderr, "ERROR: could not open file to save session to %s\n", tmp.c_str());
+            return false;
+        }
+
+        FileHeader h;
+        memset(&h, 0, sizeof(h));
+        h.magic       = MAGIC;
+        h.version     = VERSION;
+        h.originX     = area.x;
+        h.originY     = area.y;
+        h.width       = area.w;
+        h.height      = area.h;
+        h.tileSize    = TILE;
+        h.tilesX      = (area.w + TILE - 1) / TILE;
+        h.tilesY      = (area.h + TILE - 1) / TILE;
+        h.lampEnabled = view.lampEnabled;
+        h.cameraX     = view.cameraX;
+        h.cameraY     = view.cameraY;
+        h.scale       = view.scale;
+        h.lampRadius  = view.lampRadius;
+        h.strokeCount = strokeCount;
+        h.pointCount  = pointCount;
+
+        const size_t tileCount = (size_t)h.tilesX * h.tilesY;
+        h.tileIndexOffset = sizeof(FileHeader);
+        h.strokeOffset    = h.tileIndexOffset + tileCount * sizeof(TileEntry);
+        h.pointOffset     = h.strokeOffset + strokeCount * sizeof(Stroke);
+        uint64_t offset   = h.pointOffset + pointCount * sizeof(Point);
+
+        std::vector<TileEntry> index(tileCount);
+        fwrite(&h, sizeof(h), 1, f);
+        fwrite(index.data(), sizeof(TileEntry), tileCount, f); // patched below
+        if (strokeCount) fwrite(strokes, sizeof(Stroke), strokeCount, f);
+        if (pointCount)  fwrite(points, sizeof(Point), pointCount, f);
+
+        std::vector<uint8_t> raw(TILE * TILE * 4), packed(compressBound(TILE * TILE * 4));
+        for (size_t i = 0; i < tileCount; ++i) {
+            int x, y, w, ht;
+            tileRect(h, i, x, y, w, ht);
+            for (int row = 0; row < ht; ++row) {
+                memcpy(&raw[row * w * 4], pixels + ((size_t)(y + row) * h.width + x) * 4, w * 4);
+            }
+            uLongf len = packed.size();
+            compress2(packed.data(), &len, raw.data(), w * ht * 4, Z_BEST_SPEED);
+            fwrite(packed.data(), 1, len, f);
+            index[i].offset = offset;
+            index[i].size   = len;
+            offset += len;
+        }
+        fseek(f, h.tileIndexOffset, SEEK_SET);
+        fwrite(index.data(), sizeof(TileEntry), tileCount, f);
+
+        bool ok = !ferror(f);
+        ok = (fclose(f) == 0) && ok;
+        if (!ok || rename(tmp.c_str(), path) < 0) {
+            fprintf(stderr, "ERROR: could not write session to %s\n", path);
+            unlink(tmp.c_str());
+            return false;
+        }
+        return true;
+    }
+
+    // save() compresses the whole image, so the 's' key runs it off the event loop
+    std::thread       worker;
+    std::atomic<bool> isBusy(false), isReady(false);
+    bool              savedOk = false;
+    double            saveMs  = 0.0;
+    std::string       savingTo;
+
+    // everything passed in has to stay alive and unchanged until poll() reports
+    bool startSave(const char *path, const uint8_t *pixels, Selection::Rect area,
+                   const Stroke *strokes, uint64_t strokeCount, const Point *points, uint64_t pointCount)
+    {
+        if (isBusy) {
+            printf("Still saving session to %s\n", savingTo.c_str());
+            return false;
+        }
+        savingTo = path;
+        isBusy   = true;
+        View view = currentView();
+        worker = std::thread([=]() {
+            auto t0 = std::chrono::steady_clock::now();
+            savedOk = save(savingTo.c_str(), pixels, area, view, strokes, strokeCount, points, pointCount);
+            auto t1 = std::chrono::steady_clock::now();
+            saveMs  = std::chrono::duration<double, std::milli>(t1 - t0).count();
+            isReady = true;
+        });
+        return true;
+    }
+
+    // call once per frame, reports the save once it is done
+    void poll()
+    {
+        if (!isReady) return;
+        worker.join();
+        isReady = false;
+        isBusy  = false;
+        if (savedOk) printf("Saved session to %s in %.2fms\n", savingTo.c_str(), saveMs);
+    }
+
+    void stop()
+    {
+        if (worker.joinable()) worker.join();
+        poll();
+    }
+
+    bool load(const char *path, Mapped &m)
+    {
+        int fd = open(path, O_RDONLY);
+        if (fd < 0) {
+            fprintf(stderr, "ERROR: could not open session %s: %s\n", path, strerror(errno));
+            return false;
+        }
+        struct stat st;
+        fstat(fd, &st);
+        void *base = st.st_size >= (off_t)sizeof(FileHeader)
+                   ? mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0)
+                   : MAP_FAILED;
+        close(fd);
+        if (base == MAP_FAILED) {
+            fprintf(stderr, "ERROR: could not map session %s\n", path);
+            return false;
+        }
+
+        const size_t      size = st.st_size;
+        FileHeader const *h    = (FileHeader const *)base;
+        const uint64_t tileCount = (uint64_t)h->tilesX * h->tilesY;
+        bool ok = h->magic == MAGIC && h->version == VERSION &&
+                  h->width  > 0 && h->width  <= MAX_SIDE &&
+                  h->height > 0 && h->height <= MAX_SIDE && h->tileSize == (uint32_t)TILE &&
+                  h->tilesX == (h->width  + h->tileSize - 1) / h->tileSize &&
+                  h->tilesY == (h->height + h->tileSize - 1) / h->tileSize &&
+                  h->tileIndexOffset <= size && tileCount <= (size - h->tileIndexOffset) / sizeof(TileEntry) &&
+                  h->strokeOffset    <= size && h->strokeCount <= (size - h->strokeOffset) / sizeof(Stroke) &&
+                  h->pointOffset     <= size && h->pointCount  <= (size - h->pointOffset)  / sizeof(Point) &&
+                  // restore() hands these to the camera, which divides by the scale
+                  std::isfinite(h->cameraX) && std::isfinite(h->cameraY) &&
+                  std::isfinite(h->scale) && h->scale >= 0.5f && std::isfinite(h->lampRadius);
+        if (!ok) {
+            fprintf(stderr, "ERROR: %s is not a version %u session\n", path, VERSION);
+            munmap(base, size);
+            return false;
+        }
+
+        // untouched until decoded, so only address space until tiles show up
+        uint8_t *pixels = new (std::nothrow) uint8_t[(size_t)h->width * h->height * 4];
+        if (pixels == nullptr) {
+            fprintf(stderr, "ERROR: not enough memory for a %ux%u session\n", h->width, h->height);
+            munmap(base, size);
+            return false;
+        }
+
+        m.base     = (uint8_t *)base;
+        m.size     = size;
+        m.header   = h;
+        m.tiles    = (TileEntry const *)(m.base + h->tileIndexOffset);
+        m.strokes  = (Stroke const *)(m.base + h->strokeOffset);
+        m.points   = (Point const *)(m.base + h->pointOffset);
+        m.pixels   = pixels;
+        m.nextTile = 0;
+        m.state.assign(tileCount, TS_EMPTY);
+        return true;
+    }
+
+    void restore(Mapped const &m)
+    {
+        Camera::bounds        = V2(m.header->width, m.header->height);
+        Camera::p             = V2(m.header->cameraX, m.header->cameraY);
+        Mouse::scaleMagnitude = m.header->scale;
+        Lamp::isEnabled       = m.header->lampEnabled;
+        Lamp::radius          = m.header->lampRadius;
+    }
+
+    void decodeTile(Mapped &m, size_t i)
+    {
+        static std::vector<uint8_t> raw(TILE * TILE * 4);
+        FileHeader const &h = *m.header;
+        int x, y, w, ht;
+        tileRect(h, i, x, y, w, ht);
+        const size_t need = (size_t)w * ht * 4;
+        if (raw.size() < need) raw.resize(need);
+
+        uLongf len = need;
+        TileEntry const &t = m.tiles[i];
+        if (t.offset > m.size || t.size > m.size - t.offset ||
+            uncompress(raw.data(), &len, m.base + t.offset, t.size) != Z_OK || len != need) {
+            fprintf(stderr, "ERROR: session tile %zu is corrupted\n", i);
+            memset(raw.data(), 0, need);
+        }
+        for (int row = 0; row < ht; ++row) {
+            memcpy(m.pixels + ((size_t)(y + row) * h.width + x) * 4, &raw[row * w * 4], w * 4);
+        }
+        m.state[i] = TS_DECODED;
+    }
+
+    void decodeAll(Mapped &m)
+    {
+        for (size_t i = 0; i < m.state.size(); ++i) {
+            if (m.state[i] == TS_EMPTY) decodeTile(m, i);
+        }
+    }
+
+    // tiles covering what screen.vert shows for the current camera
+    void visibleTiles(FileHeader const &h, int &tx0, int &ty0, int &tx1, int &ty1)
+    {
+        V2 p0 = imagePoint(V2(0.0)), p1 = imagePoint(Camera::bounds);
+        tx0 = std::max(0, (int)floor(p0.x / h.tileSize));
+        ty0 = std::max(0, (int)floor(p0.y / h.tileSize));
+        tx1 = std::min((int)h.tilesX - 1, (int)floor(p1.x / h.tileSize));
+        ty1 = std::min((int)h.tilesY - 1, (int)floor(p1.y / h.tileSize));
+    }
+
+    void upload(Mapped &m, size_t i)
+    {
+        if (m.state[i] == TS_EMPTY) decodeTile(m, i);
+        int x, y, w, ht;
+        tileRect(*m.header, i, x, y, w, ht);
+        glTexSubImage2D(GL_TEXTURE_2D, 0, x, y, w, ht, GL_BGRA, GL_UNSIGNED_BYTE,
+                        m.pixels + ((size_t)y * m.header->width + x) * 4);
+        m.state[i] = TS_UPLOADED;
+    }
+
+    // upload whatever is on screen right now, then a few more tiles per
+    // frame until the whole image is resident
+    void stream(Mapped &m, int budget)
+    {
+        if (m.nextTile >= m.state.size()) return;
+        FileHeader const &h = *m.header;
+        glBindTexture(GL_TEXTURE_2D, Gfx::texID);
+        glPixelStorei(GL_UNPACK_ROW_LENGTH, h.width);
+
+        int tx0, ty0, tx1, ty1;
+        visibleTiles(h, tx0, ty0, tx1, ty1);
+        for (int ty = ty0; ty <= ty1; ++ty) {
+            for (int tx = tx0; tx <= tx1; ++tx) {
+                size_t i = (size_t)ty * h.tilesX + tx;
+                if (m.state[i] != TS_UPLOADED) upload(m, i);
+            }
+        }
+        for (; m.nextTile < m.state.size() && budget > 0; ++m.nextTile) {
+            if (m.state[m.nextTile] != TS_UPLOADED) {
+                upload(m, m.nextTile);
+                --budget;
+            }
+        }
+        glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+    }
+
+    void unload(Mapped &m)
+    {
+        if (!m.base) return;
+        munmap(m.base, m.size);
+        delete[] m.pixels;
+        m = Mapped();
+    }
+
+    // ./zoomit --bench-session
+    // round trips a synthetic 4K session with a lot of annotations through
+    // a file and times each step of reopening it
+    bool benchmark()
+    {
+        const int W = 3840, H = 2160, STROKES = 20000, POINTS_PER_STROKE = 64;
+        const char *path = "zoomit-bench.session";
+
+        std::vector<uint8_t> pixels = syntheticDesktop(W, H);
+        std::vector<Stroke> strokes(STROKES);
+        std::vector<Point>  points((size_t)STROKES * POINTS_PER_STROKE);
+        for (int i = 0; i < STROKES; ++i) {
+            Stroke s = {(uint32_t)(i * POINTS_PER_STROKE), POINTS_PER_STROKE, 0xffff0000u + i, 2.0f + i % 5};
+            strokes[i] = s;
+        }
+        for (size_t i = 0; i < points.size(); ++i) {
+            Point pt = {(float)(i % W), (float)(i / W % H)};
+            points[i] = pt;
+        }
+
+        Camera::p             = V2(-412.5, 118.25);
+        Mouse::scaleMagnitude = 4.0f;
+        Lamp::isEnabled       = true;
+        Lamp::radius          = 123.0f;
+        Selection::Rect area  = {10, 20, W, H};
+
+        auto ms = [](std::chrono::steady_clock::time_point a, std::chrono::steady_clock::time_point b) {
+            return std::chrono::duration<double, std::milli>(b - a).count();
+        };
+        auto t0 = std::chrono::steady_clock::now();
+        if (!save(path, pixels.data(), area, currentView(), strokes.data(), strokes.size(), points.data(), points.size())) {
+            return false;
+        }
+        auto t1 = std::chrono::steady_clock::now();
+
+        Camera::p             = V2(0.0);
+        Mouse::scaleMagnitude = 1.0f;
+        Lamp::isEnabled       = false;
+        Lamp::radius          = INITIAL_RAD;
+
+        Mapped m;
+        auto t2 = std::chrono::steady_clock::now();
+        if (!load(path, m)) return false;
+        restore(m);
+        auto t3 = std::chrono::steady_clock::now();
+        int tx0, ty0, tx1, ty1;
+        visibleTiles(*m.header, tx0, ty0, tx1, ty1);
+        for (int ty = ty0; ty <= ty1; ++ty) {
+            for (int tx = tx0; tx <= tx1; ++tx) decodeTile(m, (size_t)ty * m.header->tilesX + tx);
+        }
+        auto t4 = std::chrono::steady_clock::now();
+        decodeAll(m);
+        auto t5 = std::chrono::steady_clock::now();
+
+        bool ok = m.header->originX == area.x && m.header->originY == area.y &&
+                  Camera::p.x == -412.5 && Camera::p.y == 118.25 &&
+                  Mouse::scaleMagnitude == 4.0f && Lamp::isEnabled && Lamp::radius == 123.0f &&
+                  m.header->strokeCount == strokes.size() && m.header->pointCount == points.size() &&
+                  memcmp(m.strokes, strokes.data(), strokes.size() * sizeof(Stroke)) == 0 &&
+                  memcmp(m.points, points.data(), points.size() * sizeof(Point)) == 0 &&
+                  memcmp(m.pixels, pixels.data(), pixels.size()) == 0;
+
+        printf("Session %dx%d, %d strokes, %zu points: %.1f MB on disk (%.1f MB raw)\n",
+               W, H, STROKES, points.size(), m.size / 1e6,
+               (pixels.size() + strokes.size() * sizeof(Stroke) + points.size() * sizeof(Point)) / 1e6);
+        printf("save              %8.2f ms\n", ms(t0, t1));
+        printf("load (map+check)  %8.2f ms\n", ms(t2, t3));
+        printf("visible tiles     %8.2f ms (%d tiles at scale %.0f)\n", ms(t3, t4),
+               (tx1 - tx0 + 1) * (ty1 - ty0 + 1), Mouse::scaleMagnitude);
+        printf("all tiles         %8.2f ms\n", ms(t4, t5));
+        printf("round trip        %s\n", ok ? "ok" : "MISMATCH");
+
+        unload(m);
+        unlink(path);
+        return ok;
+    }
+}
+
+// Publishes every rendered frame into a memfd backed ring of slots so local
+// consumers (OBS, a streaming compositor, examples/framesink.cpp) can mmap it
+// instead of screen capturing our window. The fd is reachable through a
+// symlink to /proc/<pid>/fd/<fd> in $XDG_RUNTIME_DIR.
+//
+// Writing frame n (starting at 1) goes into slot n % slotCount: the slot's
+// seq becomes 2n - 1 while the pixels are written and 2n once they are
+// complete, then header.latest becomes n. A reader takes latest, uses the
+// pixels in place and checks that seq is still 2n afterwards.
+namespace Publish
+{
+    const uint32_t MAGIC   = 0x54494d5a; // "ZMIT"
+    const uint32_t VERSION = 1;
+    const uint32_t FORMAT_BGRA8888 = 0x41524742; // "BGRA", top row first
+    const int      SLOT_COUNT = 3;
+
+    struct Header {
+        uint32_t magic;
+        uint32_t version;
+        uint32_t slotOffset; // of the first slot, from the start of the mapping
+        uint32_t slotSize;   // distance between slots, including the Slot header
+        uint32_t slotCount;
+        uint32_t format;
+        uint32_t width, height;
+        uint32_t stride;     // bytes per row
+        uint32_t pad;
+        std::atomic<uint64_t> latest; // newest complete frame, 0 = none yet
+    };
+
+    struct Slot {
+        std::atomic<uint64_t> seq;
+        uint64_t frame;
+        uint64_t timestampNs; // CLOCK_MONOTONIC when the frame was rendered
+        uint64_t pad[5];      // pixels start on a cache line
+    };
+
+    static_assert(sizeof(Slot) == 64, "Slot header must stay one cache line");
+
+    bool        isEnabled = false;
+    int         fd        = -1;
+    uint8_t    *base      = nullptr;
+    size_t      size      = 0;
+    Header     *header    = nullptr;
+    std::string linkPath;
+
+    int      width = 0, height = 0;
+    uint64_t frame = 0;
+    GLuint   pbos[2];
+    bool     pboFull[2]  = {false, false};
+    uint64_t pboStamp[2] = {0, 0};
+    int      pboNext     = 0;
+
+    uint64_t nowNs()
+    {
+        timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+    }
+
+    Slot *slotAt(uint64_t n)
+    {
+        return (Slot *)(base + header->slotOffset + (n % header->slotCount) * header->slotSize);
+    }
+
+    void init(int w, int h)
+    {
+        width  = w;
+        height = h;
+        const size_t page      = sysconf(_SC_PAGESIZE);
+        const size_t frameSize = (size_t)w * h * 4;
+        const size_t slotSize  = (sizeof(Slot) + frameSize + page - 1) / page * page;
+        const size_t slotOff   = (sizeof(Header) + page - 1) / page * page;
+        size = slotOff + slotSize * SLOT_COUNT;
+
+        fd = memfd_create("zoomit-frames", MFD_CLOEXEC);
+        if (fd < 0 || ftruncate(fd, size) < 0) {
+            fprintf(stderr, "ERROR: could not create shared frame buffer: %s\n", strerror(errno));
+            exit(1);
+        }
+        base = (uint8_t *)mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if (base == MAP_FAILED) {
+            fprintf(stderr, "ERROR: could not map shared frame buffer: %s\n", strerror(errno));
+            exit(1);
+        }
+
+        header = new (base) Header();
+        header->magic      = MAGIC;
+        header->version    = VERSION;
+        header->slotOffset = slotOff;
+        header->slotSize   = slotSize;
+        header->slotCount  = SLOT_COUNT;
+        header->format     = FORMAT_BGRA8888;
+        header->width      = w;
+        header->height     = h;
+        header->stride     = w * 4;
+        header->latest.store(0);
+        for (int i = 0; i < SLOT_COUNT; ++i) new (slotAt(i)) Slot();
+
+        const char *dir = getenv("XDG_RUNTIME_DIR");
+        linkPath = std::string(dir ? dir : "/tmp") + "/zoomit-frames";
+        std::string target = "/proc/" + std::to_string(getpid()) + "/fd/" + std::to_string(fd);
+        unlink(linkPath.c_str());
+        if (symlink(target.c_str(), linkPath.c_str()) < 0) {
+            fprintf(stderr, "WARNING: could not link %s: %s\n", linkPath.c_str(), strerror(errno));
+        }
+
+        // frames are read back through two PBOs, so the copy into the ring
+        // never waits on the frame the GPU is still drawing
+        glGenBuffers(2, pbos);
+        for (int i = 0; i < 2; ++i) {
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, pbos[i]);
+            glBufferData(GL_PIXEL_PACK_BUFFER, frameSize, nullptr, GL_STREAM_READ);
+        }
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+        isEnabled = true;
+        printf("Publishing %dx%d frames to %s (%zu bytes, %d slots)\n", w, h, linkPath.c_str(), size, SLOT_COUNT);
+    }
+
+    void publish(const uint8_t *pixels, uint64_t stamp)
+    {
+        const uint64_t n      = ++frame;
+        const size_t   stride = (size_t)width * 4;
+        Slot *slot = slotAt(n);
+        slot->seq.store(2 * n - 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        // GL reads bottom row first, consumers get the top row first
+        uint8_t *dst = (uint8_t *)(slot + 1);
+        for (int y = 0; y < height; ++y) {
+            memcpy(dst + y * stride, pixels + (height - 1 - y) * stride, stride);
+        }
+        slot->frame       = n;
+        slot->timestampNs = stamp;
+        slot->seq.store(2 * n, std::memory_order_release);
+        header->latest.store(n, std::memory_order_release);
+    }
+
+    // call after rendering and before swapping
+    void readback()
+    {
+        const int i = pboNext;
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, pbos[i]);
+        if (pboFull[i]) {
+            void *pixels = glMapBuffer(GL_PIXEL_PACK_BUFFER, GL_READ_ONLY);
+            if (pixels) {
+                publish((const uint8_t *)pixels, pboStamp[i]);
+                glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+            }
+        }
+        glReadPixels(0, 0, width, height, GL_BGRA, GL_UNSIGNED_BYTE, 0);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        pboFull[i]  = true;
+        pboStamp[i] = nowNs();
+        pboNext     = i ^ 1;
+    }
+
+    void cleanup()
+    {
+        if (!isEnabled) return;
+        glDeleteBuffers(2, pbos);
+        unlink(linkPath.c_str());
+        munmap(base, size);
+        close(fd);
+        isEnabled = false;
+        printf("Published %llu frames\n", (unsigned long long)frame);
+    }
+}
+
+// Pixel values and per channel statistics straight from the captured image.
+// Hovering shows the pixel under the cursor, dragging a rectangle computes
+// histogram, mean and variance over it. Results go to stdout and to a small
+// overlay (shaders/overlay.frag).
+namespace Inspector
+{
+    enum Channel {
+        CH_R = 0,
+        CH_G,
+        CH_B,
+        CH_COUNT
+    };
+
+    struct Stats {
+        uint32_t hist[CH_COUNT][256];
+        uint64_t count;
+        double   mean[CH_COUNT], variance[CH_COUNT];
+        int      min[CH_COUNT], max[CH_COUNT];
+        int      threads;
+    };
+
+    bool   isEnabled   = false;
+    bool   isSelecting = false;
+    bool   hasStats    = false;
+    V2     anchor(0.0), corner(0.0); // image coordinates
+    Stats  stats;
+    Selection::Rect area = {0, 0, 0, 0};
+    GLuint histTexID;
+
+    // analyze() runs off the event loop, poll() picks the result up
+    std::thread       worker;
+    std::atomic<bool> isBusy(false), isReady(false);
+    Stats             pending;
+    Selection::Rect   pendingArea = {0, 0, 0, 0};
+    double            pendingMs   = 0.0;
+
+    // A histogram is a scatter of increments, which SSE/AVX2 have no
+    // instruction for. What helps instead is giving neighbouring pixels
+    // their own tables so the increments don't wait on each other.
+    void histogramRows(const uint8_t *pixels, int stride, Selection::Rect r, int y0, int y1,
+                       uint32_t (*out)[256])
+    {
+        std::vector<uint32_t> tables(4 * CH_COUNT * 256, 0);
+        uint32_t (*h)[CH_COUNT][256] = (uint32_t (*)[CH_COUNT][256])tables.data();
+        for (int y = y0; y < y1; ++y) {
+            const uint8_t *p = pixels + (size_t)y * stride + r.x * 4;
+            int x = 0;
+            for (; x + 4 <= r.w; x += 4, p += 16) {
+                ++h[0][CH_R][p[2]];  ++h[0][CH_G][p[1]];  ++h[0][CH_B][p[0]];
+                ++h[1][CH_R][p[6]];  ++h[1][CH_G][p[5]];  ++h[1][CH_B][p[4]];
+                ++h[2][CH_R][p[10]]; ++h[2][CH_G][p[9]];  ++h[2][CH_B][p[8]];
+                ++h[3][CH_R][p[14]]; ++h[3][CH_G][p[13]]; ++h[3][CH_B][p[12]];
+            }
+            for (; x < r.w; ++x, p += 4) {
+                ++h[0][CH_R][p[2]]; ++h[0][CH_G][p[1]]; ++h[0][CH_B][p[0]];
+            }
+        }
+        for (int c = 0; c < CH_COUNT; ++c) {
+            for (int i = 0; i < 256; ++i) out[c][i] = h[0][c][i] + h[1][c][i] + h[2][c][i] + h[3][c][i];
+        }
+    }
+
+    // pixels are BGRX with width * 4 bytes per row, r has to be inside of them
+    Stats analyze(const uint8_t *pixels, int width, Selection::Rect r, int threads)
+    {
+        Stats res;
+        memset(&res, 0, sizeof(res));
+        threads = std::max(1, std::min(threads, r.h / 64));
+        res.threads = threads;
+
+        std::vector<uint32_t> partial((size_t)threads * CH_COUNT * 256);
+        std::vector<std::thread> workers;
+        for (int t = 0; t < threads; ++t) {
+            int y0 = r.y + (int)((int64_t)r.h * t / threads),
+                y1 = r.y + (int)((int64_t)r.h * (t + 1) / threads);
+            uint32_t (*out)[256] = (uint32_t (*)[256])&partial[(size_t)t * CH_COUNT * 256];
+            if (t == threads - 1) {
+                histogramRows(pixels, width * 4, r, y0, y1, out);
+            } else {
+                workers.push_back(std::thread(histogramRows, pixels, width * 4, r, y0, y1, out));
+            }
+        }
+        for (std::thread &w : workers) w.join();
+
+        // the moments fall out of the histogram, no second pass needed
+        res.count = (uint64_t)r.w * r.h;
+        for (int c = 0; c < CH_COUNT; ++c) {
+            double sum = 0.0, sumSq = 0.0;
+            res.min[c] = 255;
+            res.max[c] = 0;
+            for (int i = 0; i < 256; ++i) {
+                uint32_t n = 0;
+                for (int t = 0; t < threads; ++t) n += partial[((size_t)t * CH_COUNT + c) * 256 + i];
+                res.hist[c][i] = n;
+                if (n == 0) continue;
+                sum   += (double)i * n;
+                sumSq += (double)i * i * n;
+                res.min[c] = std::min(res.min[c], i);
+                res.max[c] = std::max(res.max[c], i);
+            }
+            if (res.count) {
+                res.mean[c]     = sum / res.count;
+                res.variance[c] = sumSq / res.count - res.mean[c] * res.mean[c];
+            }
+        }
+        return res;
+    }
+
+    int defaultThreads()
+    {
+        return std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    void initTexture()
+    {
+        glGenTextures(1, &histTexID);
+        glBindTexture(GL_TEXTURE_2D, histTexID);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB32F, 256, 1, 0, GL_RGB, GL_FLOAT, nullptr);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glBindTexture(GL_TEXTURE_2D, 0);
+    }
+
+    // bar heights for the overlay, square root so a big flat background
+    // doesn't flatten everything else
+    void uploadHistogram()
+    {
+        uint32_t peak = 1;
+        for (int c = 0; c < CH_COUNT; ++c) {
+            for (int i = 0; i < 256; ++i) peak = std::max(peak, stats.hist[c][i]);
+        }
+        float bars[256 * CH_COUNT];
+        for (int i = 0; i < 256; ++i) {
+            for (int c = 0; c < CH_COUNT; ++c) bars[i * CH_COUNT + c] = sqrt((double)stats.hist[c][i] / peak);
+        }
+        glBindTexture(GL_TEXTURE_2D, histTexID);
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, 256, 1, GL_RGB, GL_FLOAT, bars);
+        glBindTexture(GL_TEXTURE_2D, Gfx::texID);
+    }
+
+    bool pixelAt(const uint8_t *pixels, int width, int height, V2 image, uint8_t bgr[3])
+    {
+        int x = (int)floor(image.x), y = (int)floor(image.y);
+        if (x < 0 || y < 0 || x >= width || y >= height) return false;
+        memcpy(bgr, pixels + ((size_t)y * width + x) * 4, 3);
+        return true;
+    }
+
+    void begin(V2 image)
+    {
+        isSelecting = true;
+        anchor = corner = image;
+    }
+
+    void finish(const uint8_t *pixels, int width, int height)
+    {
+        isSelecting = false;
+        Selection::Rect r = Selection::fromCorners((int)floor(anchor.x), (int)floor(anchor.y),
+                                                   (int)floor(corner.x), (int)floor(corner.y));
+        r = Selection::clip(r, width, height);
+        if (r.w < 2 || r.h < 2) {
+            // a click, print the pixel
+            uint8_t bgr[3];
+            if (pixelAt(pixels, width, height, anchor, bgr)) {
+                printf("Pixel %d,%d: #%02x%02x%02x (%d, %d, %d)\n", (int)floor(anchor.x), (int)floor(anchor.y),
+                       bgr[2], bgr[1], bgr[0], bgr[2], bgr[1], bgr[0]);
+            }
+            return;
+        }
+
+        if (isBusy) {
+            printf("Inspector still busy with the last region\n");
+            return;
+        }
+        pendingArea = r;
+        isBusy      = true;
+        worker      = std::thread([pixels, width, r]() {
+            auto t0 = std::chrono::steady_clock::now();
+            pending = analyze(pixels, width, r, defaultThreads());
+            auto t1 = std::chrono::steady_clock::now();
+            pendingMs = std::chrono::duration<double, std::milli>(t1 - t0).count();
+            isReady   = true;
+        });
+    }
+
+    // call once per frame, shows the statistics once they are in
+    void poll()
+    {
+        if (!isReady) return;
+        worker.join();
+        isReady  = false;
+        isBusy   = false;
+        stats    = pending;
+        area     = pendingArea;
+        hasStats = true;
+        uploadHistogram();
+
+        static const char *names[CH_COUNT] = {"R", "G", "B"};
+        printf("Region %dx%d+%d+%d (%llu px) in %.2fms on %d threads\n", area.w, area.h, area.x, area.y,
+               (unsigned long long)stats.count, pendingMs, stats.threads);
+        for (int c = 0; c < CH_COUNT; ++c) {
+            printf("  %s: mean %6.2f stddev %6.2f min %3d max %3d\n", names[c],
+                   stats.mean[c], sqrt(stats.variance[c]), stats.min[c], stats.max[c]);
+        }
+    }
+
+    void stop()
+    {
+        if (worker.joinable()) worker.join();
+        isReady = false;
+        isBusy  = false;
+    }
+
+    void render(GLuint program, const uint8_t *pixels, int width, int height)
+    {
+        using namespace Gfx;
+        V2 a(-10.0), b(-10.0);
+        if (isSelecting) {
+            a = screenPoint(V2(std::min(anchor.x, corner.x), std::min(anchor.y, corner.y)));
+            b = screenPoint(V2(std::max(anchor.x, corner.x), std::max(anchor.y, corner.y)));
+        } else if (hasStats) {
+            a = screenPoint(V2(area.x, area.y));
+            b = screenPoint(V2(area.x + area.w, area.y + area.h));
+        }
+        uint8_t bgr[3] = {0, 0, 0};
+        pixelAt(pixels, width, height, imagePoint(Mouse::current), bgr);
+
+        glUseProgram(program);
+        glActiveTexture(GL_TEXTURE1);
+        glBindTexture(GL_TEXTURE_2D, histTexID);
+        glActiveTexture(GL_TEXTURE0);
+        glUniform1i(glGetUniformLocation(program, uName[U_HISTOGRAM]), 1);
+        glUniform2f(glGetUniformLocation(program, uName[U_IMG_SZ]), width, height);
+        glUniform4f(glGetUniformLocation(program, uName[U_SELECTION]), a.x, a.y, b.x, b.y);
+        glUniform3f(glGetUniformLocation(program, uName[U_PROBE_COLOR]), bgr[2] / 255.0, bgr[1] / 255.0, bgr[0] / 255.0);
+        glUniform3f(glGetUniformLocation(program, uName[U_MEAN_COLOR]),
+                    stats.mean[CH_R] / 255.0, stats.mean[CH_G] / 255.0, stats.mean[CH_B] / 255.0);
+        glUniform1f(glGetUniformLocation(program, uName[U_HAS_STATS]), hasStats ? 1.0 : 0.0);
+        glBindVertexArray(vao);
+        glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
+    }
+
+    // ./zoomit --bench-inspect
+    bool benchmark()
+    {
+        const int W = 3840, H = 2160, RUNS = 20;
+        std::vector<uint8_t> image = syntheticDesktop(W, H);
+        Selection::Rect full = {0, 0, W, H};
+        const int threads = defaultThreads();
+
+        // always split the work for the check, even on a single core
+        Stats single = analyze(image.data(), W, full, 1);
+        Stats multi  = analyze(image.data(), W, full, std::max(threads, 4));
+        bool ok = memcmp(single.hist, multi.hist, sizeof(single.hist)) == 0;
+
+        // spot check against a plain loop
+        double sum = 0.0;
+        for (size_t i = 0; i < image.size(); i += 4) sum += image[i + 2];
+        ok = ok && fabs(sum / ((double)W * H) - multi.mean[CH_R]) < 1e-6;
+
+        for (int t : {1, threads}) {
+            double best = 1e9, total = 0.0;
+            for (int run = 0; run < RUNS; ++run) {
+                auto t0 = std::chrono::steady_clock::now();
+                analyze(image.data(), W, full, t);
+                auto t1 = std::chrono::steady_clock::now();
+                double ms = std::chrono::duration<double, std::milli>(t1 - t0).count();
+                best   = std::min(best, ms);
+                total += ms;
+            }
+            printf("%dx%d on %2d threads: best %6.2f ms, average %6.2f ms\n", W, H, t, best, total / RUNS);
+        }
+        printf("R mean %.3f stddev %.3f, results %s\n", multi.mean[CH_R], sqrt(multi.variance[CH_R]), ok ? "ok" : "MISMATCH");
+        return ok;
+    }
+}
+
+// Uploads a capture to an image host (GOALS: "Copy to imgur") without ever
+// holding the whole PNG. Rows are encoded on a background thread and every
+// compressed piece goes straight into a chunked multipart/form-data body.
+//
+// Only plain http is spoken, imgur itself wants https so --upload-url has to
+// point at a TLS terminating proxy for it. examples/uploadsink.cpp is a local
+// stand-in for testing.
+namespace Upload
+{
+    enum State {
+        US_IDLE = 0,
+        US_RUNNING,
+        US_DONE,
+        US_FAILED,
+        US_CANCELLED,
+        US_COUNT
+    };
+
+    static_assert(US_COUNT == 5, "Update list of upload states");
+    static const char *usName[US_COUNT] = {
+        [US_IDLE]      = "idle",
+        [US_RUNNING]   = "running",
+        [US_DONE]      = "done",
+        [US_FAILED]    = "failed",
+        [US_CANCELLED] = "cancelled",
+    };
+
+    const size_t CHUNK    = 64 * 1024;
+    const char  *BOUNDARY = "zoomit-7f3a9c2e51b04d68";
+
+    const int CONNECT_TIMEOUT_MS = 10000,
+              IO_TIMEOUT_S       = 30; // only a backstop, abort() shuts the socket down
+
+    std::string url = "http://127.0.0.1:8080/3/image";
+
+    std::thread           worker;
+    std::atomic<int>      state(US_IDLE);
+    std::atomic<bool>     cancel(false);
+    std::atomic<int>      rowsDone(0);
+    std::atomic<uint64_t> bytesSent(0);
+
+    // the connected socket, so abort() can wake a worker blocked in send or recv
+    std::mutex sockLock;
+    int        sock = -1;
+
+    // owned by the worker while state is US_RUNNING
+    const uint8_t *pixels = nullptr;
+    int         width = 0, height = 0;
+    double      firstByteMs = 0.0, firstPixelsMs = 0.0, totalMs = 0.0;
+    size_t      bufferBytes = 0; // everything the pipeline allocates
+    std::string error, response;
+    int         lastProgress = -1;
+    bool        reported     = true;
+
+    std::chrono::steady_clock::time_point startTime;
+
+    double sinceStart()
+    {
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startTime).count();
+    }
+
+    struct Endpoint {
+        std::string host, port, path;
+    };
+
+    bool parseUrl(std::string const &u, Endpoint &e)
+    {
+        const std::string scheme = "http://";
+        if (u.compare(0, scheme.size(), scheme) != 0) return false;
+        size_t slash = u.find('/', scheme.size());
+        std::string hostPort = u.substr(scheme.size(), slash == std::string::npos ? std::string::npos : slash - scheme.size());
+        e.path = slash == std::string::npos ? "/" : u.substr(slash);
+        size_t colon = hostPort.rfind(':');
+        e.host = hostPort.substr(0, colon);
+        e.port = colon == std::string::npos ? "80" : hostPort.substr(colon + 1);
+        return !e.host.empty() && !e.port.empty();
+    }
+
+    // polls in short steps so a cancel is noticed while the peer is silent
+    bool waitFor(int fd, short events, int timeoutMs)
+    {
+        for (int waited = 0; waited < timeoutMs && !cancel.load(); waited += 100) {
+            pollfd p = {fd, events, 0};
+            int n = poll(&p, 1, 100);
+            if (n > 0) return true;
+            if (n < 0 && errno != EINTR) return false;
+        }
+        return false;
+    }
+
+    struct Address {
+        int              family, socktype, protocol;
+        sockaddr_storage addr;
+        socklen_t        len;
+    };
+
+    // getaddrinfo can't be interrupted, so it runs on a thread of its own
+    // which is left to finish by itself when the upload is cancelled first
+    bool resolve(Endpoint const &e, std::vector<Address> &out)
+    {
+        std::promise<std::vector<Address>> found;
+        std::future<std::vector<Address>>  result = found.get_future();
+        std::thread([](Endpoint e, std::promise<std::vector<Address>> found) {
+            addrinfo hints, *res = nullptr;
+            memset(&hints, 0, sizeof(hints));
+            hints.ai_family   = AF_UNSPEC;
+            hints.ai_socktype = SOCK_STREAM;
+            std::vector<Address> list;
+            if (getaddrinfo(e.host.c_str(), e.port.c_str(), &hints, &res) == 0) {
+                for (addrinfo *a = res; a; a = a->ai_next) {
+                    Address addr;
+                    addr.family   = a->ai_family;
+                    addr.socktype = a->ai_socktype;
+                    addr.protocol = a->ai_protocol;
+                    addr.len      = std::min<socklen_t>(a->ai_addrlen, sizeof(addr.addr));
+                    memcpy(&addr.addr, a->ai_addr, addr.len);
+                    list.push_back(addr);
+                }
+                freeaddrinfo(res);
+            }
+            found.set_value(list);
+        }, e, std::move(found)).detach();
+
+        while (result.wait_for(std::chrono::milliseconds(100)) != std::future_status::ready) {
+            if (cancel.load()) return false;
+        }
+        out = result.get();
+        return !out.empty();
+    }
+
+    int connectTo(Endpoint const &e)
+    {
+        std::vector<Address> addrs;
+        if (!resolve(e, addrs)) return -1;
+        int fd = -1;
+        for (size_t i = 0; i < addrs.size() && fd < 0 && !cancel.load(); ++i) {
+            Address const &a = addrs[i];
+            fd = socket(a.family, a.socktype | SOCK_NONBLOCK, a.protocol);
+            if (fd < 0) continue;
+            int       err = 0;
+            socklen_t len = sizeof(err);
+            bool connected = connect(fd, (sockaddr const *)&a.addr, a.len) == 0 ||
+                             (errno == EINPROGRESS && waitFor(fd, POLLOUT, CONNECT_TIMEOUT_MS) &&
+                              getsockopt(fd, SOL_SOCKET, SO_ERROR, &err, &len) == 0 && err == 0);
+            if (!connected) {
+                close(fd);
+                fd = -1;
+            }
+        }
+        if (fd < 0) return -1;
+
+        // blocking from here on, with timeouts in case the peer stops reading or answering
+        fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) & ~O_NONBLOCK);
+        timeval timeout = {IO_TIMEOUT_S, 0};
+        setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+        setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+        std::lock_guard<std::mutex> lock(sockLock);
+        sock = fd;
+        // abort() may have run before sock was set
+        if (cancel.load()) shutdown(fd, SHUT_RDWR);
+        return fd;
+    }
+
+    // the request body, sent as HTTP/1.1 chunks of about CHUNK bytes
+    struct Body {
+        int fd;
+        std::vector<uint8_t> buf;
+
+        bool sendAll(const void *data, size_t len)
+        {
+            const uint8_t *p = (const uint8_t *)data;
+            while (len > 0) {
+                if (cancel.load()) return false;
+                ssize_t n = send(fd, p, len, MSG_NOSIGNAL);
+                if (n < 0) {
+                    if (errno == EINTR) continue;
+                    error = errno == EAGAIN || errno == EWOULDBLOCK ? "timed out sending" : strerror(errno);
+                    return false;
+                }
+                p   += n;
+                len -= n;
+                bytesSent += n;
+            }
+            return true;
+        }
+
+        bool sendChunk(const void *data, size_t len)
+        {
+            char head[32];
+            int  n = snprintf(head, sizeof(head), "%zx\r\n", len);
+            if (firstByteMs == 0.0) firstByteMs = sinceStart();
+            return sendAll(head, n) && sendAll(data, len) && sendAll("\r\n", 2);
+        }
+
+        bool flush()
+        {
+            if (buf.empty()) return true;
+            bool ok = sendChunk(buf.data(), buf.size());
+            buf.clear();
+            return ok;
+        }
+
+        bool write(const void *data, size_t len)
+        {
+            if (buf.size() + len > CHUNK && !flush()) return false;
+            // big pieces go out as they are instead of through buf
+            if (len >= CHUNK) return sendChunk(data, len);
+            buf.insert(buf.end(), (const uint8_t *)data, (const uint8_t *)data + len);
+            return true;
+        }
+
+        bool write(std::string const &s)
+        {
+            return write(s.data(), s.size());
+        }
+
+        bool finish()
+        {
+            return flush() && sendAll("0\r\n\r\n", 5);
+        }
+    };
+
+    void put32(uint8_t *p, uint32_t v)
+    {
+        p[0] = v >> 24; p[1] = v >> 16; p[2] = v >> 8; p[3] = v;
+    }
+
+    bool pngChunk(Body &body, const char *type, const uint8_t *data, uint32_t len)
+    {
+        uint8_t head[8], tail[4];
+        put32(head, len);
+        memcpy(head + 4, type, 4);
+        uint32_t crc = crc32(0, head + 4, 4);
+        if (len) crc = crc32(crc, data, len);
+        put32(tail, crc);
+        return body.write(head, 8) && (len == 0 || body.write(data, len)) && body.write(tail, 4);
+    }
+
+    bool encodePNG(Body &body)
+    {
+        static const uint8_t signature[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'};
+        uint8_t ihdr[13] = {0};
+        put32(ihdr,     width);
+        put32(ihdr + 4, height);
+        ihdr[8] = 8; // bits per channel
+        ihdr[9] = 2; // RGB
+        if (!body.write(signature, 8) || !pngChunk(body, "IHDR", ihdr, 13)) return false;
+        // get something on the wire now rather than after the first CHUNK of pixels
+        if (!body.flush()) return false;
+
+        z_stream z;
+        memset(&z, 0, sizeof(z));
+        if (deflateInit(&z, Z_BEST_SPEED) != Z_OK) return false;
+        // half a CHUNK, so IDAT chunks get batched into the body buffer
+        std::vector<uint8_t> row(1 + width * 3), idat(CHUNK / 2);
+        // deflate keeps a 32K window and its hash tables, about 256K at the defaults
+        bufferBytes = row.size() + idat.size() + body.buf.capacity() + (256 << 10);
+        z.next_out  = idat.data();
+        z.avail_out = idat.size();
+
+        bool ok = true;
+        for (int y = 0; y <= height && ok; ++y) {
+            const int mode = y < height ? Z_NO_FLUSH : Z_FINISH;
+            if (y < height) {
+                // Sub filter, every byte minus the same channel one pixel to the left
+                const uint8_t *src = pixels + (size_t)y * width * 4;
+                uint8_t pr = 0, pg = 0, pb = 0;
+                row[0] = 1;
+                for (int x = 0; x < width; ++x) {
+                    uint8_t r = src[x * 4 + 2], g = src[x * 4 + 1], b = src[x * 4 + 0];
+                    row[1 + x * 3 + 0] = r - pr;
+                    row[1 + x * 3 + 1] = g - pg;
+                    row[1 + x * 3 + 2] = b - pb;
+                    pr = r; pg = g; pb = b;
+                }
+                z.next_in  = row.data();
+                z.avail_in = row.size();
+            }
+            int res = Z_OK;
+            do {
+                res = deflate(&z, mode);
+                if (z.avail_out == 0 || res == Z_STREAM_END) {
+                    size_t produced = idat.size() - z.avail_out;
+                    if (produced) ok = pngChunk(body, "IDAT", idat.data(), produced);
+                    if (firstPixelsMs == 0.0) firstPixelsMs = sinceStart();
+                    z.next_out  = idat.data();
+                    z.avail_out = idat.size();
+                }
+            } while (ok && (z.avail_in > 0 || (mode == Z_FINISH && res != Z_STREAM_END)));
+            if (y < height) rowsDone = y + 1;
+            ok = ok && !cancel.load();
+        }
+        deflateEnd(&z);
+        return ok && pngChunk(body, "IEND", nullptr, 0);
+    }
+
+    void run(Endpoint e, std::string clientID)
+    {
+        int  fd = connectTo(e);
+        bool ok = fd >= 0;
+        if (!ok) error = "could not connect to " + e.host + ":" + e.port;
+
+        if (ok) {
+            std::string head =
+                "POST " + e.path + " HTTP/1.1\r\n"
+                "Host: " + e.host + (e.port == "80" ? "" : ":" + e.port) + "\r\n"
+                "User-Agent: zoomit\r\n" +
+                (clientID.empty() ? "" : "Authorization: Client-ID " + clientID + "\r\n") +
+                "Content-Type: multipart/form-data; boundary=" + BOUNDARY + "\r\n"
+                "Transfer-Encoding: chunked\r\n"
+                "Connection: close\r\n"
+                "\r\n";
+            std::string partHead = std::string("--") + BOUNDARY + "\r\n"
+                "Content-Disposition: form-data; name=\"image\"; filename=\"zoomit.png\"\r\n"
+                "Content-Type: image/png\r\n"
+                "\r\n";
+            std::string partTail = std::string("\r\n--") + BOUNDARY + "--\r\n";
+
+            Body body;
+            body.fd = fd;
+            body.buf.reserve(CHUNK);
+            ok = body.sendAll(head.data(), head.size()) && body.write(partHead) &&
+                 encodePNG(body) && body.write(partTail) && body.finish();
+        }
+
+        if (ok) {
+            char buf[4096];
+            for (ssize_t n; (n = recv(fd, buf, sizeof(buf), 0)) > 0 && response.size() < 65536; ) {
+                response.append(buf, n);
+            }
+            int status = 0;
+            sscanf(response.c_str(), "HTTP/%*d.%*d %d", &status);
+            ok = status >= 200 && status < 300;
+            if (!ok) error = response.empty() ? "no answer from server" :
+                             "server answered: " + response.substr(0, response.find("\r\n"));
+        }
+        if (fd >= 0) {
+            std::lock_guard<std::mutex> lock(sockLock);
+            sock = -1;
+            close(fd);
+        }
+
+        totalMs = sinceStart();
+        state   = cancel.load() ? US_CANCELLED : ok ? US_DONE : US_FAILED;
+    }
+
+    // the pixels are BGRX and have to stay alive until the upload is over
+    bool start(const uint8_t *bgrx, int w, int h)
+    {
+        if (state == US_RUNNING) {
+            printf("Upload already running\n");
+            return false;
+        }
+        if (worker.joinable()) worker.join();
+        Endpoint e;
+        if (!parseUrl(url, e)) {
+            fprintf(stderr, "ERROR: only http:// upload urls are supported, got %s\n", url.c_str());
+            return false;
+        }
+        const char *clientID = getenv("IMGUR_CLIENT_ID");
+
+        pixels        = bgrx;
+        width         = w;
+        height        = h;
+        firstByteMs   = firstPixelsMs = totalMs = 0.0;
+        bufferBytes   = 0;
+        lastProgress  = -1;
+        reported      = false;
+        error.clear();
+        response.clear();
+        cancel    = false;
+        rowsDone  = 0;
+        bytesSent = 0;
+        state     = US_RUNNING;
+        startTime = std::chrono::steady_clock::now();
+        worker    = std::thread(run, e, std::string(clientID ? clientID : ""));
+        printf("Uploading %dx%d to %s\n", w, h, url.c_str());
+        return true;
+    }
+
+    // call once per frame, reports progress and the result
+    void poll()
+    {
+        const int s = state.load();
+        if (s == US_RUNNING) {
+            int progress = height ? rowsDone.load() * 10 / height : 0;
+            if (progress != lastProgress) {
+                printf("Upload %d%% (%llu bytes sent)\n", progress * 10, (unsigned long long)bytesSent.load());
+                lastProgress = progress;
+            }
+            return;
+        }
+        if (reported) return;
+        reported = true;
+        if (worker.joinable()) worker.join();
+        printf("Upload %s: %llu bytes in %.2fms, first byte after %.2fms, first pixels after %.2fms, %zu KB of buffers\n",
+               usName[s], (unsigned long long)bytesSent.load(), totalMs, firstByteMs, firstPixelsMs, bufferBytes >> 10);
+        if (s == US_FAILED) fprintf(stderr, "ERROR: upload failed: %s\n", error.c_str());
+        if (s == US_DONE) {
+            size_t bodyStart = response.find("\r\n\r\n");
+            printf("%s\n", bodyStart == std::string::npos ? "" : response.substr(bodyStart + 4, 1024).c_str());
+        }
+    }
+
+    // safe to call from the main thread at any point of the upload
+    void abort()
+    {
+        cancel = true;
+        std::lock_guard<std::mutex> lock(sockLock);
+        if (sock >= 0) shutdown(sock, SHUT_RDWR);
+    }
+
+    void stop()
+    {
+        abort();
+        if (worker.joinable()) worker.join();
+        poll();
+    }
+
+    long maxRssKB()
+    {
+        rusage usage;
+        getrusage(RUSAGE_SELF, &usage);
+        return usage.ru_maxrss;
+    }
+
+    // ./zoomit [--upload-url URL] --bench-upload
+    bool benchmark()
+    {
+        const int W = 3840, H = 2160;
+        std::vector<uint8_t> image = syntheticDesktop(W, H);
+        const long rssBefore = maxRssKB();
+        if (!start(image.data(), W, H)) return false;
+        while (state == US_RUNNING) {
+            poll();
+            usleep(10000);
+        }
+        poll();
+        const long rssAfter = maxRssKB();
+        printf("Peak RSS %ld KB before, %ld KB after (%.1f MB image in memory)\n",
+               rssBefore, rssAfter, image.size() / 1e6);
+        return state == US_DONE;
+    }
+}
+
+int main(int argc, char **argv)
+{
+    bool selectRegion = false,
+         publish      = false;
+    bool benchUpload = false,
+         allOutputs  = false;
+    const char *loadPath = nullptr,
+               *savePath = "zoomit.session";
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--bench-convert") == 0) {
+            return PixelFormat::benchmark() ? 0 : 1;
+        }
+        if (strcmp(argv[i], "--bench-inspect") == 0) {
+            return Inspector::benchmark() ? 0 : 1;
+        }
+        if (strcmp(argv[i], "--bench-session") == 0) {
+            return Session::benchmark() ? 0 : 1;
+        }
+        if (strcmp(argv[i], "--load") == 0 && i + 1 < argc) {
+            loadPath = argv[++i];
+            continue;
+        }
+        if (strcmp(argv[i], "--save") == 0 && i + 1 < argc) {
+            savePath = argv[++i];
+            continue;
+        }
+        if (strcmp(argv[i], "--upload-url") == 0 && i + 1 < argc) {
+            Upload::url = argv[++i];
+            continue;
+        }
+        if (strcmp(argv[i], "--bench-upload") == 0) {
+            benchUpload = true;
+            continue;
+        }
+        if (strcmp(argv[i], "--all-outputs") == 0) {
+            allOutputs = true;
+            continue;
+        }
+        if (strcmp(argv[i], "--region") == 0) {
+            selectRegion = true;
+            continue;
+        }
+        if (strcmp(argv[i], "--publish") == 0) {
+            publish = true;
+            continue;
+        }
+        fprintf(stderr, "ERROR: unknown argument %s\n", argv[i]);
+        exit(1);
+    }
+    if (benchUpload) return Upload::benchmark() ? 0 : 1;
+
     Display *display;
     display = XOpenDisplay(nullptr);
     if (display == nullptr) {
@@ -348,8 +2326,58 @@ int main()
     XWindowAttributes attributes;
     XGetWindowAttributes(display, root, &attributes);
 
-    Screenshoot scroot(display, root, attributes.width, attributes.height);
-    scroot.capture();
+    Selection::Rect area = {0, 0, attributes.width, attributes.height};
+    std::vector<Outputs::Output> outputs = Outputs::query(display, root);
+    for (Outputs::Output const &o : outputs) {
+        printf("Output %s: %dx%d+%d+%d @ %.2fHz\n", o.name.c_str(), o.rect.w, o.rect.h, o.rect.x, o.rect.y, o.refresh);
+    }
+    int active = -1;
+
+    Session::Mapped session;
+    if (loadPath) {
+        auto loadStart = std::chrono::steady_clock::now();
+        if (!Session::load(loadPath, session)) exit(1);
+        Session::restore(session);
+        auto loadEnd = std::chrono::steady_clock::now();
+        Session::FileHeader const *h = session.header;
+        Selection::Rect saved = {h->originX, h->originY, (int)h->width, (int)h->height};
+        area = saved;
+        printf("Loaded session %s in %.2fms\n", loadPath,
+               std::chrono::duration<double, std::milli>(loadEnd - loadStart).count());
+    } else if (selectRegion) {
+        if (!Selection::select(display, root, area)) {
+            printf("No region selected\n");
+            XCloseDisplay(display);
+            return(0);
+        }
+        area = Selection::clip(area, attributes.width, attributes.height);
+        if (area.w == 0 || area.h == 0) {
+            fprintf(stderr, "ERROR: selected region is outside of the screen\n");
+            exit(1);
+        }
+    } else if (!allOutputs && !outputs.empty()) {
+        active = Outputs::underPointer(display, root, outputs);
+        area   = Selection::clip(outputs[active].rect, attributes.width, attributes.height);
+    }
+    // a region or session may span outputs, time frames against the one it mostly sits on
+    if (active < 0 && !allOutputs && !outputs.empty()) {
+        active = Outputs::at(outputs, area.x + area.w / 2, area.y + area.h / 2);
+    }
+    if (active >= 0) {
+        FrameStats::output     = outputs[active].name;
+        FrameStats::expectedMs = outputs[active].refresh > 0.0 ? 1000.0 / outputs[active].refresh : 0.0;
+    }
+
+    Screenshoot scroot(display, root, area.x, area.y, area.w, area.h);
+    if (session.base) {
+        scroot.data = (char *)session.pixels;
+    } else {
+        auto captureStart = std::chrono::steady_clock::now();
+        scroot.capture();
+        auto captureEnd = std::chrono::steady_clock::now();
+        printf("Captured %dx%d+%d+%d on %s in %.2fms\n", area.w, area.h, area.x, area.y, FrameStats::output.c_str(),
+               std::chrono::duration<double, std::milli>(captureEnd - captureStart).count());
+    }
 
     XCloseDisplay(display);
 
@@ -362,10 +2390,11 @@ int main()
     SDL_GL_SetAttribute( SDL_GL_CONTEXT_PROFILE_MASK, SDL_GL_CONTEXT_PROFILE_CORE );
     SDL_GL_SetAttribute(SDL_GL_DOUBLEBUFFER, 1);
 
-    const int TARGET_WIDTH  = attributes.width,
-              TARGET_HEIGHT = attributes.height;
+    const int TARGET_WIDTH  = scroot.width,
+              TARGET_HEIGHT = scroot.height;
+    Camera::bounds = V2(TARGET_WIDTH, TARGET_HEIGHT);
 
-    SDL_Window *appWindow = SDL_CreateWindow("ZoomIt", 0, 0, TARGET_WIDTH, TARGET_HEIGHT, SDL_WINDOW_OPENGL | SDL_WINDOW_SHOWN);
+    SDL_Window *appWindow = SDL_CreateWindow("ZoomIt", scroot.x, scroot.y, TARGET_WIDTH, TARGET_HEIGHT, SDL_WINDOW_OPENGL | SDL_WINDOW_SHOWN);
     if (appWindow == nullptr) {
         fprintf(stderr, "ERROR: could not create SDL window\n");
         exit(1);
@@ -404,6 +2433,7 @@ int main()
     GLuint programs[Gfx::P_COUNT];
     programs[Gfx::P_SCENE]   = Gfx::createProgram("shaders/bg.vert", "shaders/bg.frag");
     programs[Gfx::P_DESKTOP] = Gfx::createProgram("shaders/screen.vert", "shaders/screen.frag");
+    programs[Gfx::P_OVERLAY] = Gfx::createProgram("shaders/bg.vert", "shaders/overlay.frag");
 
     Gfx::initVertexAttrib(GL_STATIC_DRAW, []() {
         // position
@@ -420,11 +2450,16 @@ int main()
         glEnableVertexAttribArray(Gfx::VA_TEXCOORD);
     });
 
-    Gfx::initTexture(scroot.data, V2(scroot.width, scroot.height));
+    // sessions fill the texture in tile by tile, see Session::stream
+    Gfx::initTexture(session.base ? nullptr : scroot.data, V2(scroot.width, scroot.height));
+
+    Inspector::initTexture();
 
     glViewport(0, 0, scroot.width, scroot.height);
     glUseProgram(programs[Gfx::P_DESKTOP]);
 
+    if (publish) Publish::init(TARGET_WIDTH, TARGET_HEIGHT);
+
     SDL_StartTextInput();
     bool quit = false;
     uint64_t lastTick = 0;
@@ -459,13 +2494,25 @@ int main()
 
                 // Relating to panning
                 case SDL_MOUSEBUTTONDOWN: {
+                    // the inspector takes the left button, the others still pan
+                    if (Inspector::isEnabled && e.button.button == SDL_BUTTON_LEFT) {
+                        Inspector::begin(imagePoint(Mouse::current));
+                        break;
+                    }
                     Mouse::previous = Mouse::current;
                     Mouse::isDragging = true;
                 } break;
                 case SDL_MOUSEBUTTONUP: {
+                    if (Inspector::isSelecting && e.button.button == SDL_BUTTON_LEFT) {
+                        Inspector::finish((const uint8_t *)scroot.data, scroot.width, scroot.height);
+                        break;
+                    }
                     Mouse::isDragging = false;
                 } break;
                 case SDL_MOUSEMOTION: {
+                    if (Inspector::isSelecting) {
+                        Inspector::corner = imagePoint(V2(e.motion.x, e.motion.y));
+                    }
                     if (Mouse::isDragging) {
                         Camera::p += world(Mouse::current) - world(Mouse::previous);
                         Camera::velocity = (Mouse::current - Mouse::previous) * V2(20.0);
@@ -487,6 +2534,32 @@ int main()
                     if (e.text.text[0] == 'f') {
                         Lamp::isEnabled = !Lamp::isEnabled;
                     }
+                    if (e.text.text[0] == 't') {
+                        FrameStats::report();
+                    }
+                    if (e.text.text[0] == 'i') {
+                        Inspector::isEnabled   = !Inspector::isEnabled;
+                        Inspector::isSelecting = false;
+                        // the inspector reads pixels anywhere, not just where the view streamed
+                        if (session.base && Inspector::isEnabled) Session::decodeAll(session);
+                    }
+                    if (e.text.text[0] == 'u') {
+                        if (session.base) Session::decodeAll(session);
+                        Upload::start((const uint8_t *)scroot.data, scroot.width, scroot.height);
+                    }
+                    if (e.text.text[0] == 'x') {
+                        Upload::abort();
+                    }
+                    if (e.text.text[0] == 's') {
+                        if (session.base) Session::decodeAll(session);
+                        // there is no annotation tool yet, loaded strokes are kept as they are
+                        const Session::Stroke *strokes = session.base ? session.strokes : nullptr;
+                        const Session::Point  *points  = session.base ? session.points  : nullptr;
+                        uint64_t strokeCount = session.base ? session.header->strokeCount : 0,
+                                 pointCount  = session.base ? session.header->pointCount  : 0;
+                        Session::startSave(savePath, (const uint8_t *)scroot.data, area,
+                                           strokes, strokeCount, points, pointCount);
+                    }
                 } break;
             }
         }
@@ -496,7 +2569,12 @@ int main()
         currentTick = SDL_GetPerformanceCounter();
         deltaTime = (double)((currentTick - lastTick) / (double)SDL_GetPerformanceFrequency());
         update(deltaTime);
+        FrameStats::record(deltaTime);
         GloballyAvail::time += deltaTime;
+        if (session.base) Session::stream(session, 8);
+        Upload::poll();
+        Inspector::poll();
+        Session::poll();
 
         // rendering
         using namespace Gfx;
@@ -519,11 +2597,23 @@ int main()
                 glUniform1f(glGetUniformLocation(programs[P_DESKTOP], uName[U_LAMP_SHADOW]), Lamp::shadow);
                 glBindVertexArray(vao);
                 glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
+            },
+            [&]() {
+                if (Inspector::isEnabled) {
+                    Inspector::render(programs[P_OVERLAY], (const uint8_t *)scroot.data, scroot.width, scroot.height);
+                }
             }
         });
+        if (Publish::isEnabled) Publish::readback();
         SDL_GL_SwapWindow(appWindow);
     }
 
+    FrameStats::report();
+    Upload::stop();
+    Inspector::stop();
+    Session::stop();
+    Publish::cleanup();
+    Session::unload(session);
     Gfx::cleanup();
 
     SDL_StopTextInput();